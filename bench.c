@@ -0,0 +1,404 @@
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "utilities.h"
+#include "block.h"
+#include "camera.h"
+#include "globals.h"
+#include "graphics.h"
+#include "rand.h"
+#include "filter.h"
+#include "block_cache.h"
+#include "block_pool.h"
+#include "colormap.h"
+#include "worker.h"
+
+
+/// this is the benchmark program (it is built instead of main.c by the Bench build targets).
+// it times the hot paths of the program with the high resolution timer (SDL_GetPerformanceCounter()) and writes the results as JSON.
+// every benchmark is run a few times to warm up (the results are thrown away), and then it is timed over and over. Every call is timed by itself.
+// the minimum, median, mean, maximum, and standard deviation of the calls are reported in microseconds.
+// the same seed always makes the same world, so the results of two versions of the program can be compared.
+//
+// command line options:
+//	--seed N		the world seed (default 1)
+//	--repeat N		how many timed calls each benchmark gets (default 50)
+//	--warmup N		how many calls each benchmark gets before the timing starts (default 5)
+//	--threads N		how many worker threads generate blocks (0 = one per extra CPU)
+//	--filter TEXT	only runs the benchmarks with TEXT in their names
+//	--output FILE	writes the JSON to FILE instead of stdout
+
+#define BENCH_DEFAULT_REPEAT	50
+#define BENCH_DEFAULT_WARMUP	5
+// the neighbor benchmarks start at the bottom of a chain of blocks this deep (and every depth in between that is a power of 2).
+#define BENCH_MAX_DEPTH			64
+// this is the size of the surface the drawing benchmarks draw on.
+#define BENCH_SURFACE_SIZE		(BLOCK_WIDTH*3)
+
+
+/// this is one benchmark.
+struct benchCase{
+	// this is the name that goes in the results (the JSON).
+	char name[64];
+	// run is timed. setup (before) and teardown (after) are not. They can be NULL.
+	// i is the number of the call (the warm up calls come first).
+	void (*setup)(int i);
+	void (*run)(int i);
+	void (*teardown)(int i);
+	// the benchmark gets the number of repeats divided by this (at least 3). This is for the benchmarks that take a long time.
+	int repeatDivisor;
+};
+
+
+// this is everything the benchmarks work on.
+static struct blockData *benchOrigin = NULL;
+static struct blockData *benchDeep = NULL;
+static SDL_Surface *benchSurface = NULL;
+static Uint32 *benchPixels = NULL;
+static float benchScratch[BLOCK_WIDTH*BLOCK_HEIGHT];
+// this is a copy of a block's elevation (see bench_check_eviction()).
+static float benchSaved[BLOCK_WIDTH][BLOCK_HEIGHT];
+
+
+
+/// this gets the block cache ready to throw away everything but the first "blocks" blocks that were generated (see bench_forget()).
+// the blocks that stay have to be protected by a pin (see block_cache_pin()). A pin protects the block's siblings and all of its ancestors (they can't be evicted while they have children).
+static void bench_keep(long long blocks){
+	// the cache evicts down to BLOCK_CACHE_LOW_WATER_PERCENT of the budget. This makes that come out to exactly "blocks".
+	block_cache_set_max_blocks((blocks*100 + BLOCK_CACHE_LOW_WATER_PERCENT - 1)/BLOCK_CACHE_LOW_WATER_PERCENT);
+}
+
+
+/// this evicts the blocks that aren't kept (see bench_keep()), so the next call has to generate them again.
+static void bench_forget(){
+	block_cache_tick();
+	block_cache_evict();
+}
+
+
+
+//--------------------------------------------------
+// the benchmarks
+//--------------------------------------------------
+
+static void bench_random_fill(int i){
+	block_random_fill(benchOrigin, 0, 0xffffff);
+	(void)i;
+}
+
+static void bench_rand_fill_float(int i){
+	rand_fill_float(benchScratch, BLOCK_WIDTH*BLOCK_HEIGHT, 0, 0xffffff, block_get_world_seed(), (unsigned long long)i);
+}
+
+static void bench_generate_children(int i){
+	block_generate_children(benchOrigin);
+	(void)i;
+}
+
+static void bench_forget_teardown(int i){
+	bench_forget();
+	(void)i;
+}
+
+static void bench_generate_neighbor(int i){
+	block_generate_neighbor(benchDeep, BLOCK_NEIGHBOR_RIGHT);
+	(void)i;
+}
+
+static void bench_lowpass_setup(int i){
+	block_random_fill(benchOrigin, 0, 0xffffff);
+	(void)i;
+}
+
+static void bench_lowpass(int i){
+	filter_lowpass_2D_f((float *)benchOrigin->elevation, NULL, BLOCK_WIDTH, BLOCK_HEIGHT, 3);
+	(void)i;
+}
+
+static void bench_smooth(int i){
+	block_smooth(benchOrigin, 0.5f);
+	(void)i;
+}
+
+static void bench_convert_raw(int i){
+	static const struct colormap raw = {COLORMAP_RAW, 0, 0, NULL, 0};
+	colormap_convert_block(benchOrigin->elevation, benchPixels, BLOCK_WIDTH*sizeof(Uint32), &raw);
+	(void)i;
+}
+
+static void bench_convert_palette(int i){
+	colormap_convert_block(benchOrigin->elevation, benchPixels, BLOCK_WIDTH*sizeof(Uint32), colormap_current());
+	(void)i;
+}
+
+static void bench_draw_line(int i){
+	// the lines go almost all the way across the surface, and turn a little every call.
+	float a = i*0.1f;
+	float c = BENCH_SURFACE_SIZE/2.0f;
+	float r = c*0.9f;
+	draw_line(benchSurface, c - r*cosf(a), c - r*sinf(a), c + r*cosf(a), c + r*sinf(a), 3, 0xffff0000);
+}
+
+static void bench_draw_circle(int i){
+	draw_circle(benchSurface, BENCH_SURFACE_SIZE/2.0f, BENCH_SURFACE_SIZE/2.0f, BENCH_SURFACE_SIZE/3.0f + i%10, 0xff00ff00);
+}
+
+static void bench_draw_rect(int i){
+	draw_rect(benchSurface, i%10, i%10, BENCH_SURFACE_SIZE/2, BENCH_SURFACE_SIZE/2, 2, 0xff0000ff, 0xffffffff, 1);
+}
+
+
+
+//--------------------------------------------------
+// timing and results
+//--------------------------------------------------
+
+/// this is used by qsort() to sort the times.
+static int bench_compare(const void *a, const void *b){
+	double da = *(const double *)a;
+	double db = *(const double *)b;
+	if(da < db) return -1;
+	if(da > db) return 1;
+	return 0;
+}
+
+
+/// this runs one benchmark and writes its results to fp as a JSON object.
+// returns 0 on success
+// returns 1 if there was not enough memory for the times
+static short bench_run(FILE *fp, const struct benchCase *bc, int repeat, int warmup, char first){
+
+	if(bc->repeatDivisor > 1) repeat /= bc->repeatDivisor;
+	if(repeat < 3) repeat = 3;
+	double *times = malloc(repeat*sizeof(double));
+	if(times == NULL){
+		error("bench_run() could not allocate memory for the times. times = NULL");
+		return 1;
+	}
+
+	double frequency = (double)SDL_GetPerformanceFrequency();
+	int i;
+	for(i=0; i<warmup+repeat; i++){
+		if(bc->setup != NULL) bc->setup(i);
+		Uint64 start = SDL_GetPerformanceCounter();
+		bc->run(i);
+		Uint64 end = SDL_GetPerformanceCounter();
+		if(bc->teardown != NULL) bc->teardown(i);
+		if(i >= warmup) times[i-warmup] = (end - start)*1e6/frequency;
+	}
+
+	double mean = 0, deviation = 0;
+	for(i=0; i<repeat; i++) mean += times[i];
+	mean /= repeat;
+	for(i=0; i<repeat; i++) deviation += (times[i] - mean)*(times[i] - mean);
+	deviation = sqrt(deviation/repeat);
+	qsort(times, repeat, sizeof(double), bench_compare);
+	double median = (repeat%2) ? times[repeat/2] : (times[repeat/2-1] + times[repeat/2])/2;
+
+	fprintf(fp, "%s\n\t\t{\"name\": \"%s\", \"unit\": \"us\", \"repeat\": %d, \"warmup\": %d, \"min\": %.3f, \"median\": %.3f, \"mean\": %.3f, \"max\": %.3f, \"stddev\": %.3f}",
+		first ? "" : ",", bc->name, repeat, warmup, times[0], median, mean, times[repeat-1], deviation);
+	fflush(fp);
+
+	free(times);
+	return 0;
+}
+
+
+
+/// this checks that evicting blocks and generating them again doesn't change how the world looks (see block_cache.h).
+// first the children of block are generated, and so are the children of its top left child (so that child is built from its children, see block_mip.h).
+// both sets are evicted and generated again, and block's elevation has to be exactly what it was.
+// then it is done again one level deeper. This time the top left child is mip-locked, so it has to stay (along with its siblings).
+// last, an edited block has to survive being evicted, and keep its changes when its children are generated.
+// everything that can be evicted is thrown away afterwards (see bench_keep()). The blocks under block that are mip-locked stay.
+// returns 0 if the checks pass
+// returns 1 if the blocks could not be generated or evicted
+// returns 2 if block changed when its children were generated again
+// returns 3 if block changed when its grandchildren were generated again
+// returns 4 if an edited block was evicted
+// returns 5 if an edited block was built from its children
+// returns 6 if a mip-locked block was evicted
+// returns 7 if block changed when the sets three levels down were generated again
+static short bench_check_eviction(struct blockData *block, long long worldBlocks){
+
+	if(block_generate_children(block) || block_generate_children(block->children[BLOCK_CHILD_TOP_LEFT])) return 1;
+	memcpy(benchSaved, block->elevation, sizeof(benchSaved));
+
+	// evict both sets. The grandchildren go first, and then the children (once they have become leaves).
+	bench_keep(worldBlocks);
+	bench_forget();
+	if(block->children[0] != NULL || !block->mipLocked) return 1;
+
+	// the top left child is built from its children again when it comes back, so block has to look the same.
+	if(block_generate_children(block)) return 1;
+	if(memcmp(benchSaved, block->elevation, sizeof(benchSaved)) || block->mipLocked) return 2;
+	// once the top left child's children are back, the child is built from them again, and that has to match too.
+	struct blockData *child = block->children[BLOCK_CHILD_TOP_LEFT];
+	if(block_generate_children(child)) return 1;
+	if(memcmp(benchSaved, block->elevation, sizeof(benchSaved))) return 3;
+
+	// one level deeper. The top left grandchild is built from its children, and then both of the sets under child are evicted.
+	// child is mip-locked after that, so it (and its siblings) can't be evicted.
+	if(block_generate_children(child->children[BLOCK_CHILD_TOP_LEFT])) return 1;
+	memcpy(benchSaved, block->elevation, sizeof(benchSaved));
+	bench_keep(worldBlocks);
+	bench_forget();
+	if(block->children[BLOCK_CHILD_TOP_LEFT] != child || !child->mipLocked) return 6;
+	if(child->children[0] != NULL) return 1;
+	if(block_generate_children(child) || block_generate_children(child->children[BLOCK_CHILD_TOP_LEFT])) return 1;
+	if(memcmp(benchSaved, block->elevation, sizeof(benchSaved))) return 7;
+
+	// an edited block (and its siblings) can't be evicted.
+	struct blockData *edited = child->children[BLOCK_CHILD_CENTER_CENTER];
+	edited->edited = 1;
+	bench_keep(worldBlocks);
+	bench_forget();
+	short ret = (child->children[BLOCK_CHILD_CENTER_CENTER] == edited) ? 0 : 4;
+
+	// an edited block isn't built from its children (or its grandchildren) when they are generated.
+	if(ret == 0){
+		block_fill_half_vert(edited, 1000, 2000);
+		memcpy(benchSaved, edited->elevation, sizeof(benchSaved));
+		if(block_generate_children(edited) || block_generate_children(edited->children[BLOCK_CHILD_CENTER_CENTER])) ret = 1;
+		else if(memcmp(benchSaved, edited->elevation, sizeof(benchSaved))) ret = 5;
+	}
+	edited->edited = 0;
+	bench_keep(worldBlocks);
+	bench_forget();
+	return ret;
+}
+
+
+
+/// this makes a chain of blocks depth levels under the origin (always the bottom right child), and pins the one at the bottom.
+// the right neighbor of the bottom block is on the other side of the origin, so generating it has to go all the way up to the origin's level and back down.
+// returns the block at the bottom of the chain.
+static struct blockData *bench_chain(int depth){
+	struct blockData *block = benchOrigin;
+	int d;
+	for(d=0; d<depth && block != NULL; d++){
+		block_generate_children(block);
+		block = block->children[BLOCK_CHILD_BOTTOM_RIGHT];
+	}
+	if(block != NULL) block_cache_pin(block);
+	return block;
+}
+
+
+
+int main(int argc, char *argv[]){
+
+	unsigned long long seed = 1;
+	int repeat = BENCH_DEFAULT_REPEAT, warmup = BENCH_DEFAULT_WARMUP, threads = 0, arg;
+	const char *filter = NULL, *output = NULL;
+	for(arg=1; arg<argc; arg++){
+		if(strcmp(argv[arg], "--seed") == 0 && arg+1 < argc)			seed = strtoull(argv[++arg], NULL, 10);
+		else if(strcmp(argv[arg], "--repeat") == 0 && arg+1 < argc)		repeat = atoi(argv[++arg]);
+		else if(strcmp(argv[arg], "--warmup") == 0 && arg+1 < argc)		warmup = atoi(argv[++arg]);
+		else if(strcmp(argv[arg], "--threads") == 0 && arg+1 < argc)	threads = atoi(argv[++arg]);
+		else if(strcmp(argv[arg], "--filter") == 0 && arg+1 < argc)		filter = argv[++arg];
+		else if(strcmp(argv[arg], "--output") == 0 && arg+1 < argc)		output = argv[++arg];
+		else{
+			fprintf(stderr, "bench did not recognize the argument %s\n", argv[arg]);
+			return 1;
+		}
+	}
+	if(repeat < 1) repeat = 1;
+	if(warmup < 0) warmup = 0;
+
+	FILE *fp = stdout;
+	if(output != NULL){
+		fp = fopen(output, "w");
+		if(fp == NULL){
+			fprintf(stderr, "bench could not open %s\n", output);
+			return 2;
+		}
+	}
+
+	// the benchmarks don't need any windows.
+	if(SDL_Init(SDL_INIT_TIMER) == -1) return -99;
+	worker_init(threads);
+	block_set_world_seed(seed);
+	colormap_init();
+
+	benchOrigin = block_generate_origin();
+	block_generate_parent(benchOrigin);
+	block_cache_pin(benchOrigin);
+	colormap_fit_range(benchOrigin);
+	benchSurface = create_surface(BENCH_SURFACE_SIZE, BENCH_SURFACE_SIZE);
+	// draw_line() only draws on the part of the surface that would be on the screen.
+	windW = BENCH_SURFACE_SIZE;
+	windH = BENCH_SURFACE_SIZE;
+	benchPixels = malloc(BLOCK_WIDTH*BLOCK_HEIGHT*sizeof(Uint32));
+	if(benchOrigin == NULL || benchSurface == NULL || benchPixels == NULL){
+		fprintf(stderr, "bench could not set up the world\n");
+		return 3;
+	}
+
+	// the benchmarks only mean something if the block cache doesn't change the world. The check uses a sibling of the origin, so the origin is left the way the benchmarks expect it.
+	short check = bench_check_eviction(benchOrigin->parent->children[BLOCK_CHILD_TOP_LEFT], block_pool_count());
+	if(check){
+		fprintf(stderr, "bench_check_eviction() failed. The world changed when blocks were evicted and generated again. ret = %d\n", check);
+		return 4;
+	}
+
+	// these are all of the benchmarks (except the neighbor ones, which are added for every depth below).
+	struct benchCase cases[] = {
+		{"block_random_fill",					NULL,					bench_random_fill,		NULL,								1},
+		{"rand_fill_float",						NULL,					bench_rand_fill_float,	NULL,								1},
+		{"block_generate_children",				NULL,					bench_generate_children,bench_forget_teardown,				1},
+		{"filter_lowpass_2D_f",					bench_lowpass_setup,	bench_lowpass,			NULL,								1},
+		{"block_smooth",						NULL,					bench_smooth,			NULL,								5},
+		{"colormap_convert_block/raw",			NULL,					bench_convert_raw,		NULL,								1},
+		{"colormap_convert_block/palette",		NULL,					bench_convert_palette,	NULL,								1},
+		{"draw_line",							NULL,					bench_draw_line,		NULL,								1},
+		{"draw_circle",							NULL,					bench_draw_circle,		NULL,								1},
+		{"draw_rect",							NULL,					bench_draw_rect,		NULL,								1},
+	};
+	int caseCount = sizeof(cases)/sizeof(cases[0]), c, depth;
+	char first = 1;
+
+	fprintf(fp, "{\n\t\"program\": \"FractalMap bench\",\n\t\"seed\": %llu,\n\t\"threads\": %d,\n\t\"timer\": \"SDL_GetPerformanceCounter\",\n\t\"frequency\": %llu,\n\t\"results\": [",
+		seed, worker_count(), (unsigned long long)SDL_GetPerformanceFrequency());
+
+	// this is the world the benchmarks start with (the origin, its parent, and its siblings). Everything else is thrown away between calls.
+	long long worldBlocks = block_pool_count();
+	bench_keep(worldBlocks);
+	for(c=0; c<caseCount; c++){
+		if(filter != NULL && strstr(cases[c].name, filter) == NULL) continue;
+		bench_run(fp, &cases[c], repeat, warmup, first);
+		first = 0;
+	}
+
+	// the neighbor benchmarks need a chain of blocks under the origin. The chain stays, and the neighbors are thrown away after every call.
+	for(depth=1; depth<=BENCH_MAX_DEPTH; depth*=2){
+		struct benchCase neighbor = {"", NULL, bench_generate_neighbor, bench_forget_teardown, depth > 8 ? 5 : 1};
+		snprintf(neighbor.name, sizeof(neighbor.name), "block_generate_neighbor/depth %d", depth);
+		if(filter != NULL && strstr(neighbor.name, filter) == NULL) continue;
+
+		benchDeep = bench_chain(depth);
+		if(benchDeep == NULL){
+			fprintf(stderr, "bench could not generate a chain %d blocks deep\n", depth);
+			break;
+		}
+		bench_keep(block_pool_count());
+		bench_run(fp, &neighbor, repeat, warmup, first);
+		first = 0;
+		// let go of the chain so that the next one can replace it.
+		block_cache_unpin(benchDeep);
+		bench_keep(worldBlocks);
+		bench_forget();
+	}
+
+	fprintf(fp, "\n\t]\n}\n");
+	if(fp != stdout) fclose(fp);
+
+	free(benchPixels);
+	SDL_FreeSurface(benchSurface);
+	worker_quit();
+	block_pool_clean_up();
+	SDL_Quit();
+	return 0;
+}
@@ -6,9 +6,107 @@
 #include <string.h>
 #include "rand.h"
 #include "graphics.h"
+#include "block_pool.h"
+#include "block_cache.h"
+#include "worker.h"
+#include "block_index.h"
+#include "colormap.h"
+#include "block_mip.h"
+#include "trace.h"
+
+
+// this is the seed of the whole world. Every block's seed is derived from it.
+static unsigned long long blockWorldSeed = 0;
+// this protects the links between blocks (see block_lock()).
+static SDL_mutex *blockNetworkLock = NULL;
+// this is the highest block in the network (the concentric block that doesn't have a parent yet).
+static struct blockData *blockTop = NULL;
+// this goes up by one every time blocks are added to or removed from the block network (see block_graph_version()).
+static unsigned long blockGraphVersion = 0;
+
+
+/// this sets the seed that the whole world is generated from.
+// this needs to be set before the origin is generated.
+void block_set_world_seed(unsigned long long worldSeed){
+	blockWorldSeed = worldSeed;
+}
+
+
+/// returns the seed that the whole world is generated from.
+unsigned long long block_get_world_seed(){
+	return blockWorldSeed;
+}
+
+
+/// this creates the block lock.
+// the block lock protects the links between blocks (parent, children, and neighbors) when more than one thread is using the block network.
+// the main thread holds it whenever it walks or changes the network, and the prefetcher holds it whenever it publishes new blocks (see prefetch.h).
+// until this is called, block_lock() and block_unlock() don't do anything (that is fine as long as there is only one thread using the network).
+// returns 0 on success
+// returns 1 if the lock could not be created
+short block_lock_init(){
+	if(blockNetworkLock != NULL) return 0;
+	blockNetworkLock = SDL_CreateMutex();
+	if(blockNetworkLock == NULL){
+		error("block_lock_init() could not create the block lock. blockNetworkLock = NULL");
+		return 1;
+	}
+	return 0;
+}
+
+
+/// this destroys the block lock. Nothing else can be using the block network when this is called.
+void block_lock_quit(){
+	if(blockNetworkLock == NULL) return;
+	SDL_DestroyMutex(blockNetworkLock);
+	blockNetworkLock = NULL;
+}
+
+
+/// this locks the block network.
+// the lock is recursive, so a thread that already holds it can lock it again (as long as it unlocks it the same number of times).
+void block_lock(){
+	if(blockNetworkLock != NULL) SDL_LockMutex(blockNetworkLock);
+}
+
+
+/// this unlocks the block network.
+void block_unlock(){
+	if(blockNetworkLock != NULL) SDL_UnlockMutex(blockNetworkLock);
+}
+
+
+/// this tells everyone who is watching the block network that blocks were added to it or removed from it.
+// the generators and the block cache call this whenever they change a parent or child link. The block lock needs to be held.
+void block_graph_changed(){
+	blockGraphVersion++;
+}
+
+
+/// returns the version of the block network. It is different every time blocks have been added or removed since the last time you asked.
+// this is meant for things that draw the network (like the network viewer), so they only draw it again when it has changed.
+unsigned long block_graph_version(){
+	return blockGraphVersion;
+}
+
+
+/// returns the highest block in the network (NULL if the origin hasn't been generated yet).
+// generating a parent changes it, so the block lock needs to be held (see block_lock()).
+struct blockData *block_top(){
+	return blockTop;
+}
+
+
+/// returns the seed of the concentric block on the given level.
+// the origin, its parents, and its center children are all concentric, so there is exactly one on each level.
+unsigned long long block_seed_concentric(signed long long level){
+	return rand_combine(blockWorldSeed, (unsigned long long)level);
+}
+
 
 
 /// throws random data into blockData
+// the data only depends on block->seed, so filling the same block twice gives exactly the same data.
 // returns 0 on success
 // returns 1 when the block is a NULL pointer.
 short block_random_fill(struct blockData *block, float range_low, float range_high){
@@ -26,19 +124,12 @@ short block_random_fill(struct blockData *block, float range_low, float range_hi
 		range_low = temp;
 	}
 	
-	int j, i;
-	
-	// this will generate data that will statistically average zero.
-	// the data will not average zero for each set of numbers however.
-	for(i=0; i<BLOCK_WIDTH; i++){
-		for(j=0; j<BLOCK_HEIGHT; j++){
-			// generate a random number between range_low and range_high.
-			block->elevation[i][j] = ((genrand()%100001)/100000.0)*(range_high-range_low) + range_low;//((rand()%100001)/100000.0)*(range_higher-range_lower)-((range_higher+range_lower)/2);
-		}
-	}
+	// fill the whole elevation array in one go.
+	// the block's seed is the key, so it doesn't matter what was generated before it (or on what thread).
+	rand_fill_float((float *)(block->elevation), BLOCK_WIDTH*BLOCK_HEIGHT, range_low, range_high, block->seed, 0);
 	
 	// render the block next time it needs to be printed
-	block->renderMe = 1;
+	block_mark_all_dirty(block);
 	// generated random data in block successfully.
 	return 0;
 }
@@ -88,13 +179,17 @@ short block_print_to_file(struct blockData *block, char *fileName){
 }
 
 
-/// this will render a block and store a pointer to the rendered texture in the blockData itself.
-// this is useful when you don't want to render a block every time you print the screen.
-// this can be used to only re-render the block when a change in the block elevation occurs.
+/// this will render the dirty parts of a block into texture (a BLOCK_WIDTH x BLOCK_HEIGHT streaming texture from the texture cache, see texture_cache.h).
+// the pixels are written straight into the locked texture. There is no surface in between and nothing is allocated.
+// only the tiles that have changed since the last render are converted and uploaded (see block_mark_dirty()).
+// rows of tiles that are dirty in the same places are grouped into bands, and each run of dirty tiles in a band is locked and written as one rectangle. So a whole dirty block is still just one lock.
 // returns 0 on success
 // returns 1 on invalid block
-// returns 2 if blockRenderer is NULL
-short block_render(struct blockData *block, SDL_Renderer *blockRenderer){
+// returns 2 if texture is NULL
+// returns 3 if the texture could not be locked
+short block_render(struct blockData *block, SDL_Texture *texture){
+	
+	TRACE_BLOCK("block_render", block);
 	
 	// quit and report error if you were given a bad block.
 	if(block == NULL){
@@ -102,38 +197,104 @@ short block_render(struct blockData *block, SDL_Renderer *blockRenderer){
 		return 1;
 	}
 	// quit and report error if you were given a bad block.
-	if(blockRenderer == NULL){
-		error("block_render() was sent invalid blockRenderer. blockRenderer = NULL");
+	if(texture == NULL){
+		error("block_render() was sent invalid texture. texture = NULL");
 		return 2;
 	}
 	
-	// this is a pointer to where surface data is stored.
-	// the data will stay here (we can use the same surface data over and over again to render any block, because the surface is only needed temporarily.
-	static SDL_Surface *blockSurface;
-	static int firstTimeThrough = 1;
-	if(firstTimeThrough) {
-		blockSurface = create_surface(BLOCK_WIDTH, BLOCK_HEIGHT);
-		firstTimeThrough = 0;
-	}
-	
-	// if the block texture is valid, destroy it. This frees up the memory that was used to render the last texture. We no longer need it.
-	if(block->texture != NULL) SDL_DestroyTexture(block->texture);
+	const struct colormap *map = colormap_current();
+	void *pixels;
+	int pitch;
+	int tx, ty = 0;
 	
-	int i, j;
-	for(i=0; i<BLOCK_WIDTH; i++){
-		for(j=0; j<BLOCK_HEIGHT; j++){
-			set_pixel(blockSurface, i, j, ((int)(block->elevation[i][j])) | 0xff000000);
+	while(ty < BLOCK_TILES_Y){
+		unsigned short mask = block->dirtyTiles[ty];
+		// find the band of tile rows that are dirty in the same places as this one
+		int tyEnd = ty+1;
+		while(tyEnd < BLOCK_TILES_Y && block->dirtyTiles[tyEnd] == mask) tyEnd++;
+		
+		tx = 0;
+		while(mask && tx < BLOCK_TILES_X){
+			if(!(mask & (1<<tx))){
+				tx++;
+				continue;
+			}
+			// find the end of this run of dirty tiles
+			int txEnd = tx+1;
+			while(txEnd < BLOCK_TILES_X && (mask & (1<<txEnd))) txEnd++;
+			
+			SDL_Rect rect = {tx*BLOCK_TILE_SIZE, ty*BLOCK_TILE_SIZE, (txEnd-tx)*BLOCK_TILE_SIZE, (tyEnd-ty)*BLOCK_TILE_SIZE};
+			// only this rectangle of the texture is locked (and uploaded when it is unlocked).
+			if(SDL_LockTexture(texture, &rect, &pixels, &pitch)){
+				error("block_render() could not lock the texture.");
+				return 3;
+			}
+			// the colormap writes the texture one row at a time so that the writes are in order (the texture memory might be slow to write to out of order).
+			colormap_convert_region(block->elevation, rect.x, rect.y, rect.x+rect.w, rect.y+rect.h, pixels, pitch, map);
+			SDL_UnlockTexture(texture);
+			tx = txEnd;
 		}
+		ty = tyEnd;
 	}
 	
-	// copy surface to texture
-	block->texture = SDL_CreateTextureFromSurface(blockRenderer, blockSurface);
+	// the texture is up to date now. It doesn't need to be rendered again until the elevation changes.
+	for(ty=0; ty<BLOCK_TILES_Y; ty++){
+		block->dirtyTiles[ty] = 0;
+	}
 	
 	// success!
 	return 0;
 }
 
 
+
+/// this marks the elements [x0,x1) x [y0,y1) of block as changed, so that they will be rendered again.
+// every tile that the rectangle touches is marked. The rectangle is clipped to the block.
+void block_mark_dirty(struct blockData *block, int x0, int y0, int x1, int y1){
+	
+	if(block == NULL){
+		error("block_mark_dirty() was sent NULL block. block = NULL");
+		return;
+	}
+	
+	if(x0 < 0) x0 = 0;
+	if(y0 < 0) y0 = 0;
+	if(x1 > BLOCK_WIDTH) x1 = BLOCK_WIDTH;
+	if(y1 > BLOCK_HEIGHT) y1 = BLOCK_HEIGHT;
+	if(x0 >= x1 || y0 >= y1) return;
+	
+	// these are the first and last tiles that the rectangle touches
+	int tx0 = x0/BLOCK_TILE_SIZE, tx1 = (x1-1)/BLOCK_TILE_SIZE;
+	int ty0 = y0/BLOCK_TILE_SIZE, ty1 = (y1-1)/BLOCK_TILE_SIZE;
+	unsigned short mask = ((1<<(tx1+1)) - 1) & ~((1<<tx0) - 1);
+	int ty;
+	for(ty=ty0; ty<=ty1; ty++){
+		block->dirtyTiles[ty] |= mask;
+	}
+}
+
+
+
+/// this marks all of block as changed, so that all of it will be rendered again.
+// use this after you change the whole block (or when the image that was rendered for it is gone).
+void block_mark_all_dirty(struct blockData *block){
+	block_mark_dirty(block, 0, 0, BLOCK_WIDTH, BLOCK_HEIGHT);
+}
+
+
+
+/// returns 1 if any part of block needs to be rendered again.
+// returns 0 if the block is up to date (or NULL).
+char block_is_dirty(struct blockData *block){
+	if(block == NULL) return 0;
+	int ty;
+	for(ty=0; ty<BLOCK_TILES_Y; ty++){
+		if(block->dirtyTiles[ty]) return 1;
+	}
+	return 0;
+}
+
+
 /* OLD PRINTING FUNCTION
 /// this will print an image of a mapblock to a surface BLOCK_WIDTH x BLOCK_HEIGHT pixels
 // returns 0 on success
@@ -180,14 +341,14 @@ short block_print_network_hierarchy(SDL_Surface *dest, struct blockData *focus,
 	draw_rect(dest, x, y, size, size, 1, 0xff000000, color_mix_weighted(colorTop, colorBot, childLevels, childLevelsOrig-childLevels), 1);
 	
 	
-	// quit if you have printed all of the necessary children.
-	if(childLevels <= 0) return 0;
-	
 	int c;
 	
 	// print 9 more of this current block's children (if they exist)
-	for(c=0; c<BLOCK_CHILDREN; c++){
-		block_print_network_hierarchy(dest, focus->children[c], highlight, childLevelsOrig, childLevels-1, x + (c%((int)(BLOCK_LINEAR_SCALE_FACTOR)))*size/BLOCK_LINEAR_SCALE_FACTOR, y + (c/((int)(BLOCK_LINEAR_SCALE_FACTOR)))*size/BLOCK_LINEAR_SCALE_FACTOR, size/BLOCK_LINEAR_SCALE_FACTOR, colorTop, colorBot, colorHighlight);									
+	// unless you have printed all of the necessary children, or the children would be smaller than a pixel (there is nothing to see down there).
+	if(childLevels > 0 && size >= BLOCK_LINEAR_SCALE_FACTOR){
+		for(c=0; c<BLOCK_CHILDREN; c++){
+			block_print_network_hierarchy(dest, focus->children[c], highlight, childLevelsOrig, childLevels-1, x + (c%((int)(BLOCK_LINEAR_SCALE_FACTOR)))*size/BLOCK_LINEAR_SCALE_FACTOR, y + (c/((int)(BLOCK_LINEAR_SCALE_FACTOR)))*size/BLOCK_LINEAR_SCALE_FACTOR, size/BLOCK_LINEAR_SCALE_FACTOR, colorTop, colorBot, colorHighlight);									
+		}
 	}
 	
 	if(focus == highlight) draw_rect(dest, x, y, size, size, 1, colorHighlight, 0x00000000, 0);
@@ -211,7 +372,7 @@ short block_smooth(struct blockData *block, float smoothFactor){
 	}
 	
 	// render the block next time it needs to be printed
-	block->renderMe = 1;
+	block_mark_all_dirty(block);
 	// success
 	return 0;
 }
@@ -250,8 +411,6 @@ float block_surrounding_average(struct blockData *block, unsigned int x, unsigne
 		return 0.0;
 	}
 	
-	// render the block next time it needs to be printed
-	block->renderMe = 1;
 	// if everything went well, return the average of the surrounding elevations
 	return average/((float)averageCount);
 }
@@ -291,7 +450,7 @@ int block_fill_middle(struct blockData *block, float inVal, float outVal){
 	}
 	
 	// render the block next time it needs to be printed
-	block->renderMe = 1;
+	block_mark_all_dirty(block);
 	// success
 	return 0;
 }
@@ -330,7 +489,7 @@ short block_fill_nine_squares(struct blockData *block, int color) {
 			color*=2;
 	}
 	// render the block next time it needs to be printed
-	block->renderMe = 1;
+	block_mark_all_dirty(block);
 	// success
 	return 0;
 }
@@ -454,7 +613,7 @@ short block_fill_nine_squares_own_color(struct blockData *block, int one, int tw
 	}
 	
 	// render the block next time it needs to be printed
-	block->renderMe = 1;
+	block_mark_all_dirty(block);
 	// success
 	return 0;
 }
@@ -482,7 +641,7 @@ short block_fill_half_vert(struct blockData *block, float elevationLeft, float e
 	}
 	
 	// render the block next time it needs to be printed
-	block->renderMe = 1;
+	block_mark_all_dirty(block);
 	return 0;
 }
 
@@ -490,7 +649,7 @@ short block_fill_half_vert(struct blockData *block, float elevationLeft, float e
 
 
 
-/// this function will create a new origin block in memory and add that origin block to the block list using block_collector.
+/// this function will create a new origin block in memory (from the block pool).
 // this function will...
 	// set all elevation data to 0.
 	// set all child pointers to NULL.
@@ -503,10 +662,12 @@ short block_fill_half_vert(struct blockData *block, float elevationLeft, float e
 // returns NULL when allocation of memory fails
 struct blockData *block_generate_origin(){
 	
-	struct blockData *newOrigin = malloc(sizeof(struct blockData));
+	TRACE_SCOPE("block_generate_origin");
+	
+	struct blockData *newOrigin = block_pool_alloc();
 	
 	if(newOrigin == NULL){
-		error("block_generate_origin() was sent NULL newOrigin pointer.");
+		error("block_generate_origin() could not allocate the origin from the block pool. newOrigin = NULL");
 		return NULL;
 	}
 	
@@ -523,10 +684,9 @@ struct blockData *block_generate_origin(){
 	
 	// set parent to NULL;
 	newOrigin->parent = NULL;
-	// set the texture to NULL
-	newOrigin->texture = NULL;
+	block_graph_changed();
 	// render the new origin the next time through the graphics functions.
-	newOrigin->renderMe = 1;
+	block_mark_all_dirty(newOrigin);
 	
 	// set the level to the default level.
 	newOrigin->level = BLOCK_ORIGIN_LEVEL;
@@ -534,20 +694,176 @@ struct blockData *block_generate_origin(){
 	// set parentView to BLOCK_CHILD_CENTER_CENTER.
 	newOrigin->parentView = BLOCK_CHILD_CENTER_CENTER;
 	
-	// randomize the origin
-	block_random_fill(newOrigin, 0x00000000, 0xffffffff);
-	
+	// the origin is (of course) concentric with the origin.
+	newOrigin->concentric = 1;
+	newOrigin->seed = block_seed_concentric(newOrigin->level);
+	// the origin is at (0,0) on its level, like every concentric block.
+	newOrigin->addressX = 0;
+	newOrigin->addressY = 0;
+	newOrigin->addressValid = 1;
 	
+	// the origin was just used.
+	block_cache_touch(newOrigin);
 	
+	// randomize the origin (with the same range as every other block)
+	block_random_fill(newOrigin, 0, 0xffffff);
 	
-	// add origin to the block index.
-	block_collector(newOrigin, bc_collect);
+	// the origin is the first block in the network (so it doesn't have any neighbors to link to yet).
+	block_index_insert(newOrigin);
+	blockTop = newOrigin;
 	
 	return newOrigin;
 }
 
 
 
+/// this finds the block next to block in the neighbor direction, if it has been generated. Nothing is generated.
+// blocks with valid addresses are looked up in the block index.
+// the others are found through their parent (a sibling, or a child of the parent's neighbor).
+// the block lock needs to be held when this is called.
+// returns the neighbor, or NULL if it hasn't been generated (or can't be found without generating something).
+static struct blockData *block_find_neighbor(struct blockData *block, short neighbor){
+	
+	if(block->addressValid){
+		long long x = block->addressX;
+		long long y = block->addressY;
+		switch(neighbor){
+		case BLOCK_NEIGHBOR_UP:		y--; break;
+		case BLOCK_NEIGHBOR_DOWN:	y++; break;
+		case BLOCK_NEIGHBOR_LEFT:	x--; break;
+		case BLOCK_NEIGHBOR_RIGHT:	x++; break;
+		default: return NULL;
+		}
+		// a neighbor past the edge of the valid addresses isn't in the index (see block_locate()). It is found through its parent below.
+		if(llabs(x) <= 3*BLOCK_ADDRESS_MAX+1 && llabs(y) <= 3*BLOCK_ADDRESS_MAX+1) return block_index_find(block->level, x, y);
+	}
+	
+	if(block->parent == NULL) return NULL;
+	int c = block->parentView;
+	// this is the parent that the neighbor is in.
+	struct blockData *parent = block->parent;
+	// this is which child of that parent the neighbor is.
+	int n;
+	switch(neighbor){
+	case BLOCK_NEIGHBOR_UP:		if(c >= 3)	n = c-3;	else {n = c+6; parent = parent->neighbors[neighbor];}	break;
+	case BLOCK_NEIGHBOR_DOWN:	if(c < 6)	n = c+3;	else {n = c-6; parent = parent->neighbors[neighbor];}	break;
+	case BLOCK_NEIGHBOR_LEFT:	if(c%3 > 0)	n = c-1;	else {n = c+2; parent = parent->neighbors[neighbor];}	break;
+	case BLOCK_NEIGHBOR_RIGHT:	if(c%3 < 2)	n = c+1;	else {n = c-2; parent = parent->neighbors[neighbor];}	break;
+	default: return NULL;
+	}
+	if(parent == NULL) return NULL;
+	return parent->children[n];
+}
+
+
+
+/// this links a newly published block to all of its neighbors that have already been generated (in both directions).
+// this is called every time a block is published, so any two neighbors that both exist are always linked.
+// (the block cache unlinks a block from its neighbors when it is evicted, so the links never point to a block that is gone).
+// the block lock needs to be held when this is called.
+static void block_link_neighbors(struct blockData *block){
+	
+	short n;
+	for(n=0; n<BLOCK_NEIGHBORS; n++){
+		if(block->neighbors[n] != NULL) continue;
+		struct blockData *found = block_find_neighbor(block, n);
+		if(found == NULL) continue;
+		block->neighbors[n] = found;
+		found->neighbors[BLOCK_NEIGHBOR_OPPOSITE(n)] = block;
+	}
+}
+
+
+
+/// this builds a new parent for centerChild, but it does NOT link it into the block network.
+// the parent is filled with its elevation data, but it has no children yet (see block_build_children()).
+// this only reads centerChild's level, so it can run without holding the block lock (see block_lock()).
+// returns a pointer to the new parent on success
+// returns NULL if the parent could not be allocated
+struct blockData *block_build_parent(struct blockData *centerChild){
+	
+	// try to get a block for the parent from the block pool
+	struct blockData *newParent = block_pool_alloc();
+	
+	// if the parent was not allocated properly, log an error and return NULL
+	if(newParent == NULL){
+		error("block_build_parent() cannot allocate data for a parent. newParent = NULL");
+		return NULL;
+	}
+	
+	// the level of the parent is one above the level of the child.
+	newParent->level = centerChild->level + 1;
+	// every new parent is concentric with the origin (see "RYAN'S BLOCK NETWORK GENERATION PROTOCOL" in block.h).
+	newParent->concentric = 1;
+	newParent->seed = block_seed_concentric(newParent->level);
+	// so it is at (0,0) on its level.
+	newParent->addressX = 0;
+	newParent->addressY = 0;
+	newParent->addressValid = 1;
+	
+	// the parent's elevation isn't filled here. It is built from its children when they are published (see block_mip.h).
+	
+	// the parent has no parent yet, and it has not been rendered yet.
+	// (block_pool_alloc() sets all of the pointers to NULL and flags the block to be rendered).
+	// because of how block generation is performed, when generating a parent, both the child AND the parent AND the parent's parent AND the parent's parent's parent (etc...) will be concentric.
+	// so parentView for all NEW parents and the children that are generating those new parents will be BLOCK_CHILD_CENTER_CENTER.
+	// This property of the block network is explained in some detail in block.h under "RYAN'S BLOCK NETWORK GENERATION PROTOCOL"
+	newParent->parentView = BLOCK_CHILD_CENTER_CENTER;
+	
+	return newParent;
+}
+
+
+
+/// this links a parent built with block_build_parent() (and its children built with block_build_children()) into the block network.
+// siblings[] holds all 9 children of newParent. siblings[BLOCK_CHILD_CENTER_CENTER] must be centerChild.
+// if centerChild got a parent while newParent was being built, newParent and the new siblings are given back to the block pool.
+// the block lock needs to be held when this is called (see block_lock()).
+// returns 0 when newParent was linked into the network
+// returns 1 when centerChild already had a parent (nothing was linked)
+short block_publish_parent(struct blockData *centerChild, struct blockData *newParent, struct blockData *siblings[BLOCK_CHILDREN]){
+	
+	int c;
+	
+	// someone else got here first. throw the new blocks away.
+	if(centerChild->parent != NULL){
+		for(c=0; c<BLOCK_CHILDREN; c++){
+			if(siblings[c] != NULL && siblings[c] != centerChild) block_pool_free(siblings[c]);
+		}
+		block_pool_free(newParent);
+		return 1;
+	}
+	
+	// all of the children go in at once.
+	for(c=0; c<BLOCK_CHILDREN; c++){
+		newParent->children[c] = siblings[c];
+		// the new blocks were just used. This keeps the block cache from evicting them before anyone has had a chance to look at them.
+		block_cache_touch(siblings[c]);
+		if(siblings[c] != centerChild) block_index_insert(siblings[c]);
+	}
+	centerChild->parentView = BLOCK_CHILD_CENTER_CENTER;
+	centerChild->parent = newParent;
+	block_graph_changed();
+	block_cache_touch(newParent);
+	block_index_insert(newParent);
+	
+	// link the new blocks to their neighbors (only after all of them are in the index so they can find each other)
+	block_link_neighbors(newParent);
+	for(c=0; c<BLOCK_CHILDREN; c++){
+		if(siblings[c] != centerChild) block_link_neighbors(siblings[c]);
+	}
+	
+	// the parent looks like its children (see block_mip.h). It doesn't have a parent of its own yet, so there is nothing above it to update.
+	block_mip_build(newParent);
+	
+	// the new parent is the highest block in the network now.
+	if(blockTop == NULL || newParent->level > blockTop->level) blockTop = newParent;
+	
+	return 0;
+}
+
+
+
 /// this function will generate a parent when given a pointer to a block that is to be taken as the child.
 	// when any parent is generated, all of its children are automatically generated as well.
 	// the reason for this is the following: Every block will either have all of its children or none of its children.
@@ -555,9 +871,12 @@ struct blockData *block_generate_origin(){
 // returns 0 on success
 // returns 1 on NULL centerChild pointer.
 // returns 2 when the parent already exists.
-// returns 3 if the 
+// returns 3 if the parent could not be allocated
+// returns 4 if the parent's other children could not be allocated
 short block_generate_parent(struct blockData *centerChild){
 	
+	TRACE_BLOCK("block_generate_parent", centerChild);
+	
 	// check to see if a NULL pointer was passed.
 	if(centerChild == NULL){
 		error("block_generate_parent() was sent NULL pointer. centerChild = NULL.");
@@ -569,143 +888,435 @@ short block_generate_parent(struct blockData *centerChild){
 		error("block_generate_parent() was asked to regenerate parent.");
 		return 2;
 	}
-	// otherwise, the parent needs to be generated
+	
+	// build the parent
+	struct blockData *newParent = block_build_parent(centerChild);
+	if(newParent == NULL){
+		error("block_generate_parent() cannot allocate data for a parent. newParent = NULL");
+		return 3;
+	}
+	
+	// the middle child of the parent is centerChild. Create the other eight children.
+	struct blockData *siblings[BLOCK_CHILDREN];
+	int c;
+	for(c=0; c<BLOCK_CHILDREN; c++){
+		siblings[c] = NULL;
+	}
+	siblings[BLOCK_CHILD_CENTER_CENTER] = centerChild;
+	if(block_build_children(newParent, siblings)){
+		error("block_generate_parent() could not generate the children of the new parent.");
+		block_pool_free(newParent);
+		return 4;
+	}
+	
+	// put the parent and its children into the network
+	block_publish_parent(centerChild, newParent, siblings);
+	
+	// successfully generated a parent and verified all children exist or have been created.
+	return 0;
+}
+
+
+
+/// this is the work that block_build_children() hands out to the workers.
+// each worker gets one child (one index of missing[]).
+struct blockChildrenJob{
+	struct blockData *parent;
+	// these are the children that are being generated.
+	struct blockData **children;
+	// these are the child numbers (0-8) that are being generated.
+	int missing[BLOCK_CHILDREN];
+	// this is the parent's mipLocked when the job started. Bit c is set if child c has to be built from its own children (see blockData.mipLocked).
+	unsigned short rebuild;
+};
+
+
+
+/// this sets up child so that it is child c of parent (its level, seed, and address). The elevation isn't touched.
+// the child is NOT linked into its parent.
+static void block_init_child(struct blockData *parent, struct blockData *child, int c){
+	
+	// this records the the parent blocks address
+	// (block_pool_alloc() already set the child's children, neighbors, and texture to NULL and flagged it to be rendered)
+	child->parent = parent;
+	// record (in the child block) what child it is with respect to its parent.
+	// Is it child_0? child_4 or child_5? This will record that data.
+	child->parentView = c;
+	// the level of the child is the level of the parent minus 1.
+	child->level = parent->level - 1;
+	// the center child of a concentric block is concentric too. It gets the concentric seed for its level.
+	// every other child gets its seed from its parent's seed and where it sits inside its parent.
+	if(parent->concentric && c == BLOCK_CHILD_CENTER_CENTER){
+		child->concentric = 1;
+		child->seed = block_seed_concentric(child->level);
+	}
 	else{
-		
-		// try to allocate memory for the parent block
-		centerChild->parent = malloc(sizeof(struct blockData));
-		
-		// if the parent was not allocated properly, log an error and return 2
-		if(centerChild->parent == NULL){
-			error("block_generate_parent() cannot allocate data for a parent. centerChild->parent = NULL");
-			return 3;
+		child->concentric = 0;
+		child->seed = rand_combine(parent->seed, c);
+	}
+	// the child's address comes from its parent's address (unless the parent is so far down that the child's address won't fit).
+	if(parent->addressValid
+		&& parent->addressX <= BLOCK_ADDRESS_MAX && parent->addressX >= -BLOCK_ADDRESS_MAX
+		&& parent->addressY <= BLOCK_ADDRESS_MAX && parent->addressY >= -BLOCK_ADDRESS_MAX){
+		child->addressX = 3*parent->addressX + c%3 - 1;
+		child->addressY = 3*parent->addressY + c/3 - 1;
+		child->addressValid = 1;
+	}
+}
+
+
+
+/// this builds block from children that are only made long enough to build it (see block_mip_build_from()).
+// it is for a block that was built from its children before it was evicted. Those children were all random noise (see block_cache.h), so making them again and building block from them makes block exactly what it was.
+// the temporary children are never linked into the network.
+// returns 0 on success
+// returns 1 if the temporary children could not be allocated
+static short block_rebuild_from_children(struct blockData *block){
+	
+	struct blockData *temporary[BLOCK_CHILDREN];
+	int c;
+	short ret = 0;
+	for(c=0; c<BLOCK_CHILDREN; c++){
+		temporary[c] = block_pool_alloc();
+		if(temporary[c] == NULL){
+			ret = 1;
+			continue;
 		}
-		
-		// because the parent was successfully added to memory, we will add it to the block collector's list.
-		block_collector(centerChild->parent, bc_collect);
-		
-		// set elevation to default
-		/*
-		int i, j;
-		for(i=0; i<BLOCK_WIDTH; i++){
-			for(j=0; j<BLOCK_HEIGHT; j++){
-				(centerChild->parent)->elevation[i][j] = BLOCK_DEFAULT_ELEVATION;
-			}
+		block_init_child(block, temporary[c], c);
+		block_random_fill(temporary[c], 0,0xffffff);
+	}
+	if(ret == 0) block_mip_build_from(block, temporary);
+	for(c=0; c<BLOCK_CHILDREN; c++){
+		if(temporary[c] != NULL) block_pool_free(temporary[c]);
+	}
+	return ret;
+}
+
+
+
+/// this generates one child of a block. It is called by the workers (see block_build_children()).
+// it only touches the new child, so any number of these can be running at the same time.
+// the child is NOT linked into its parent. That is done after every child is finished.
+static void block_build_child_task(void *data, int index){
+	
+	struct blockChildrenJob *job = data;
+	int c = job->missing[index];	// this is the child of the parent
+	TRACE_BLOCK("block_build_child", job->parent);
+	
+	// attempt to get a block for the child from the block pool.
+	struct blockData *child = block_pool_alloc();
+	job->children[c] = child;
+	
+	// check to make sure child block was allocated correctly.
+	// block_build_children() checks for the NULL.
+	if(child == NULL) return;
+	
+	block_init_child(job->parent, child, c);
+	
+	// a child that was built from its own children before it was evicted is built the same way again.
+	if(job->rebuild & (1 << c)){
+		if(block_rebuild_from_children(child)){
+			// block_build_children() throws all of the children away when one of them is NULL.
+			block_pool_free(child);
+			job->children[c] = NULL;
 		}
-		*/
-		block_random_fill(centerChild->parent, 0,0xffffff);
-		
-		// make all of the children NULL
-		int c;
-		for(c=0; c<BLOCK_CHILDREN; c++){
-				(centerChild->parent)->children[c] = NULL;
+		return;
+	}
+	
+	// this is the child's default elevation data
+	block_random_fill(child, 0,0xffffff);
+}
+
+
+
+/// this builds the children of datParent, but it does NOT link them into datParent.
+// only the entries of children[] that are NULL are built. The other entries are left alone.
+// the children are allocated and filled in parallel by the workers (see worker.h).
+// this only reads datParent's level, seed, address, concentric flag, and mipLocked, so it can run without holding the block lock (see block_lock()).
+// returns 0 on success
+// returns 2+child for the first child that cannot be allocated in memory (none of the new children are kept in that case)
+short block_build_children(struct blockData *datParent, struct blockData *children[BLOCK_CHILDREN]){
+	
+	struct blockChildrenJob job;
+	int c;	// this is the child of the parent
+	int m, missingCount = 0;
+	
+	job.parent = datParent;
+	job.children = children;
+	job.rebuild = datParent->mipLocked;
+	// find the children that need to be generated.
+	for(c=0; c<BLOCK_CHILDREN; c++){
+		if(children[c] == NULL){
+			job.missing[missingCount++] = c;
 		}
-		// make the middle child of the parent point to the centerChild pointer
-		(centerChild->parent)->children[BLOCK_CHILD_CENTER_CENTER] = centerChild;
-		
-		// create any children that have not been generated already.
-		block_generate_children(centerChild->parent);
-		
-		// the level of the parent is one above the level of the child.
-		(centerChild->parent)->level = centerChild->level + 1;
-		
-		// the parent has not been rendered yet.
-		centerChild->parent->texture = NULL;
-		// render the parent next time through the graphics functions.
-		centerChild->parent->renderMe = 1;
-		
-		// this sets the parent of this block to NULL.
-		(centerChild->parent)->parent = NULL;
-		// because of how block generation is performed, when generating a parent, both the child AND the parent AND the parent's parent AND the parent's parent's parent (etc...) will be concentric.
-		// so parentView for all NEW parents and the children that are generating those new parents will be BLOCK_CHILD_CENTER_CENTER.
-		// This property of the block network is explained in some detail in block.h under "RYAN'S BLOCK NETWORK GENERATION PROTOCOL"
-		(centerChild->parent)->parentView = BLOCK_CHILD_CENTER_CENTER;
-		centerChild->parentView = BLOCK_CHILD_CENTER_CENTER;
-		
 	}
 	
-	// successfully generated a parent and verified all children exist or have been created.
+	// generate all of the missing children at once.
+	worker_run(block_build_child_task, &job, missingCount);
+	
+	// if any child could not be allocated, throw all of the new children away.
+	int failed = -1;
+	for(m=0; m<missingCount && failed < 0; m++){
+		if(children[job.missing[m]] == NULL) failed = job.missing[m];
+	}
+	if(failed >= 0){
+		error_d("block_build_children() could not allocate memory for children. block_pool_alloc() returned NULL. child =",failed);
+		for(m=0; m<missingCount; m++){
+			c = job.missing[m];
+			if(children[c] != NULL) block_pool_free(children[c]);
+			children[c] = NULL;
+		}
+		return 2 + failed;
+	}
+	
 	return 0;
 }
 
 
 
-/// creates all three children for the passed blockData, parent
-// this function will allocate memory for all 9 children at once.
+/// this links children built with block_build_children() into datParent.
+// every child that datParent doesn't have yet is taken from children[].
+// the entries of children[] that aren't needed (because datParent got those children while they were being built) are given back to the block pool.
+// the block lock needs to be held when this is called (see block_lock()).
+// returns the number of children that were linked into datParent.
+int block_publish_children(struct blockData *datParent, struct blockData *children[BLOCK_CHILDREN]){
+	
+	int c, published = 0;
+	for(c=0; c<BLOCK_CHILDREN; c++){
+		if(children[c] == NULL) continue;
+		if(datParent->children[c] == NULL){
+			datParent->children[c] = children[c];
+			// a child that had to be built from its own children has been (see blockData.mipLocked).
+			if(children[c]->mipBuilt) datParent->mipLocked &= ~(1 << c);
+			// the child was just used. This keeps the block cache from evicting it before anyone has had a chance to look at it.
+			block_cache_touch(children[c]);
+			block_index_insert(children[c]);
+			published++;
+		}
+		else if(datParent->children[c] != children[c]){
+			block_pool_free(children[c]);
+			children[c] = NULL;
+		}
+	}
+	
+	// link the new children to each other and to the children of the parent's neighbors.
+	// this is done after all of them are in the parent and the index so they can find each other.
+	for(c=0; c<BLOCK_CHILDREN; c++){
+		if(children[c] != NULL && datParent->children[c] == children[c]) block_link_neighbors(children[c]);
+	}
+	
+	// the parent (and the part of every ancestor that shows it) is built again from the new children (see block_mip.h).
+	// the children that were built from their own children before they were evicted are built the same way again, so the parent comes out exactly the same.
+	// if one of them couldn't be (the parent is still mip-locked), the parent is left alone. So is a parent the user has edited (building it from its children would throw the changes away).
+	if(published){
+		block_graph_changed();
+		if(!datParent->mipLocked && !datParent->edited){
+			block_mip_build(datParent);
+			block_mip_update(datParent);
+		}
+	}
+	
+	return published;
+}
+
+
+
+/// creates all nine children for the passed blockData, parent
+// the children are allocated and filled in parallel by the workers (see worker.h).
+// none of the children are put into the parent until all of them are finished, so the parent always has either all of its children or none of them.
 // returns 0 on success 
 // returns 1 for a NULL parent pointer.
-// returns 2+child for the first child that cannot be allocated in memory
+// returns 2+child for the first child that cannot be allocated in memory (none of the new children are kept in that case)
 short block_generate_children(struct blockData *datParent){
 	
+	TRACE_BLOCK("block_generate_children", datParent);
+	
 	if(datParent == NULL){
 		error("block_generate_children() was sent NULL datParent pointer. datParent = NULL");
 		return 1;
 	}
 	
+	// start with the children that already exist. only the missing ones get built.
+	struct blockData *children[BLOCK_CHILDREN];
 	int c;	// this is the child of the parent
-	int cc;	// this is the child of the child of the parent
-	// allocate space for 9 children
+	int missingCount = 0;
 	for(c=0; c<BLOCK_CHILDREN; c++){
-		
-		// only try to generate a child if the child doesn't already exist.
-		if(datParent->children[c] == NULL){
-			
-			// attempt to allocate memory for the child block.
-			datParent->children[c] = (struct blockData *) malloc(sizeof(struct blockData));
-			
-			// check to make sure child block was allocated incorrectly.
-			if(datParent->children[c] == NULL){
-				
-				error_d("block_generate_children() could not allocate memory for children. malloc() returned NULL. child =",c);
-				return 2 + c;
-				
+		children[c] = datParent->children[c];
+		if(children[c] == NULL) missingCount++;
+	}
+	if(missingCount == 0) return 0;
+	
+	short ret = block_build_children(datParent, children);
+	if(ret) return ret;
+	
+	// publish the new children together.
+	block_publish_children(datParent, children);
+	
+	// successfully generated children
+	return 0;
+}
+
+
+
+/// this gives the coordinate of the parent of a block at coordinate v (this works for x or y).
+// it is floor((v+1)/3). C division rounds towards zero, so negative numbers need to be fixed up.
+long long block_address_up(long long v){
+	long long q = (v+1)/3;
+	if((v+1)%3 < 0) q--;
+	return q;
+}
+
+
+
+/// this looks for the block at the address (level, x, y) without generating anything.
+// the block lock needs to be held when this is called.
+// returns BLOCK_LOCATE_FOUND and sets *block to the block if it exists.
+// returns BLOCK_LOCATE_NEED_CHILDREN and sets *block to the closest existing ancestor of the address (which has no children yet) if the block doesn't exist.
+// returns BLOCK_LOCATE_NEED_PARENT and sets *block to the highest block in the network if the address is outside of everything generated so far.
+// returns BLOCK_LOCATE_INVALID if the address is too big to be valid (see BLOCK_ADDRESS_MAX).
+short block_locate(signed long long level, long long x, long long y, struct blockData **block){
+
+	// the children of a block at +/-BLOCK_ADDRESS_MAX still get addresses (see block_build_child_task()), so the biggest valid address is one more than 3 times that.
+	if(x > 3*BLOCK_ADDRESS_MAX+1 || x < -3*BLOCK_ADDRESS_MAX-1 || y > 3*BLOCK_ADDRESS_MAX+1 || y < -3*BLOCK_ADDRESS_MAX-1) return BLOCK_LOCATE_INVALID;
+
+	struct blockData *found = block_index_find(level, x, y);
+	if(found != NULL){
+		*block = found;
+		return BLOCK_LOCATE_FOUND;
+	}
+
+	// climb up through the ancestors of the address until one of them exists.
+	// every child of a block with children is in the index, so the first ancestor that exists doesn't have children yet.
+	while(1){
+		// the address is above the top of the network. the top block needs a parent first.
+		if(blockTop == NULL || level >= blockTop->level){
+			*block = blockTop;
+			return BLOCK_LOCATE_NEED_PARENT;
+		}
+		level++;
+		x = block_address_up(x);
+		y = block_address_up(y);
+		found = block_index_find(level, x, y);
+		if(found != NULL){
+			*block = found;
+			return BLOCK_LOCATE_NEED_CHILDREN;
+		}
+	}
+}
+
+
+
+/// this returns the block at the address (level, x, y), generating it (and any of its ancestors that don't exist) if it needs to.
+// returns a pointer to the block on success
+// returns NULL if the address is invalid or the block could not be generated
+struct blockData *block_generate_address(signed long long level, long long x, long long y){
+
+	TRACE_ADDRESS("block_generate_address", level, x, y);
+	struct blockData *block = NULL;
+
+	// generate one level at a time until the block exists.
+	// each time through, the closest existing ancestor gets one level closer to the address.
+	while(1){
+		switch(block_locate(level, x, y, &block)){
+		case BLOCK_LOCATE_FOUND:
+			return block;
+		case BLOCK_LOCATE_NEED_CHILDREN:
+			if(block_generate_children(block)){
+				error_d("block_generate_address() could not generate children on the way to the block. level =", (int)level);
+				return NULL;
 			}
-			// if the child block was generated correctly,
-			else{
-				
-				// check the child block that was just generated into the block list.
-				// this ensures that we will be able to clean up all the allocated blocks when the program closes.
-				block_collector(datParent->children[c], bc_collect);
-				
-				// this records the the parent blocks address
-				(datParent->children[c])->parent = datParent;
-				// record (in the child block) what child it is with respect to its parent.
-				// Is it child_0? child_4 or child_5? This will record that data.
-				(datParent->children[c])->parentView = c;
-				// this sets all pointers to children for the current child to NULL.
-				for(cc=0; cc<BLOCK_CHILDREN; cc++){
-					(datParent->children[c])->children[cc] = NULL;
-				}
-				// the child has not been rendered yet
-				(datParent->children[c])->texture = NULL;
-				// render the child next time through the graphics functions.
-				(datParent->children[c])->renderMe = 1;
-				// the level of the child is the level of the parent minus 1.
-				(datParent->children[c])->level = datParent->level - 1;
-				
-				// this is the child's default elevation data
-				block_random_fill(datParent->children[c], 0,0xffffff);
-				
-				
-				
+			break;
+		case BLOCK_LOCATE_NEED_PARENT:
+			if(block == NULL || block_generate_parent(block)){
+				error_d("block_generate_address() could not generate a parent on the way to the block. level =", (int)level);
+				return NULL;
 			}
+			break;
+		default:
+			error_d("block_generate_address() was sent an invalid address. level =", (int)level);
+			return NULL;
 		}
 	}
-	// successfully generated children
-	return 0;
+}
+
+
+
+// these count the blockSteps that have been allocated since the program started, and the ones that haven't been freed yet (see block_stats.h).
+// neighbors can be generated from more than one thread, so they are protected by stepLock.
+static long long stepAllocatedCount = 0;
+static long long stepLiveCount = 0;
+static SDL_SpinLock stepLock = 0;
+
+
+
+/// this allocates one blockStep (and counts it).
+// returns NULL if it could not be allocated
+static struct blockStep *block_step_alloc(){
+	struct blockStep *stepLink = malloc(sizeof(struct blockStep));
+	if(stepLink == NULL) return NULL;
+	SDL_AtomicLock(&stepLock);
+	stepAllocatedCount++;
+	stepLiveCount++;
+	SDL_AtomicUnlock(&stepLock);
+	return stepLink;
+}
+
+
+
+/// this frees a whole linked list of blockSteps (starting from any link in the list).
+static void block_step_free(struct blockStep *stepLink){
+	if(stepLink == NULL) return;
+	// go back to the beginning of the list
+	while(stepLink->prev != NULL) stepLink = stepLink->prev;
+	// and free everything on the way to the end
+	struct blockStep *next;
+	long long freed = 0;
+	while(stepLink != NULL){
+		next = stepLink->next;
+		free(stepLink);
+		stepLink = next;
+		freed++;
+	}
+	SDL_AtomicLock(&stepLock);
+	stepLiveCount -= freed;
+	SDL_AtomicUnlock(&stepLock);
+}
+
+
+
+/// returns the number of blockSteps that have been allocated since the program started.
+long long block_step_allocated_count(){
+	SDL_AtomicLock(&stepLock);
+	long long count = stepAllocatedCount;
+	SDL_AtomicUnlock(&stepLock);
+	return count;
+}
+
+
+
+/// returns the number of blockSteps that are allocated right now. Every list is freed before block_generate_neighbor() returns, so this should be 0 between calls.
+long long block_step_live_count(){
+	SDL_AtomicLock(&stepLock);
+	long long count = stepLiveCount;
+	SDL_AtomicUnlock(&stepLock);
+	return count;
 }
 
 
 
 /// this function will calculate neighbor block(s) of the "dat" block sent to the function.
-// this function IS ONLY GUARANTEED TO WORK FOR A 3x3 BLOCK CHILDREN LAYOUT.
+// the neighbor is found (or generated) from its address (see "Block Addresses" in block.h), so this takes the same amount of time no matter how deep dat is.
+// blocks that are too deep to have a valid address (and neighbors past the edge of the valid addresses) are handled by walking up the network and back down (the old way).
 // returns 0 on success.
 // returns 1 on NULL dat block pointer.
 // returns 2 when it cannot allocate memory for the first stepLink.
 // returns 3 when it cannot allocate memory for the second, third, fourth, (etc...) stepLink in the list.
 // returns 4 if, when counting down, stepLink->prev is null BEFORE ascend = 0.
+// returns 5 if the neighbor could not be generated from its address.
 short block_generate_neighbor(struct blockData *dat, short neighbor){
 	
+	TRACE_BLOCK("block_generate_neighbor", dat);
+	
 	if(dat == NULL){
 		error("block_generate_neighbor() was sent NULL blockData pointer. dat = NULL");
 		return 1;
@@ -732,8 +1343,45 @@ short block_generate_neighbor(struct blockData *dat, short neighbor){
 		return retVal;
 	}
 	
+	// neighbors are linked as soon as they are generated (see block_link_neighbors()), so usually there is nothing to do.
+	if(neighbor >= 0 && neighbor < BLOCK_NEIGHBORS && dat->neighbors[neighbor] != NULL) return 0;
+	
+	//--------------------------------------------------
+	// find the neighbor from its address
+	//--------------------------------------------------
+	if(dat->addressValid){
+		long long x = dat->addressX;
+		long long y = dat->addressY;
+		switch(neighbor){
+		case BLOCK_NEIGHBOR_UP:		y--; break;
+		case BLOCK_NEIGHBOR_DOWN:	y++; break;
+		case BLOCK_NEIGHBOR_LEFT:	x--; break;
+		case BLOCK_NEIGHBOR_RIGHT:	x++; break;
+		default:
+			error_d("block_generate_neighbor() was sent an invalid neighbor direction. neighbor =", neighbor);
+			return -1;
+		}
+		
+		// on the edge of the valid addresses, dat can have an address while its neighbor doesn't (the neighbor's parent is past BLOCK_ADDRESS_MAX).
+		// that neighbor can't be found by its address, so it is found by walking the network below.
+		struct blockData *found;
+		if(block_locate(dat->level, x, y, &found) != BLOCK_LOCATE_INVALID){
+			found = block_generate_address(dat->level, x, y);
+			if(found == NULL){
+				error_d("block_generate_neighbor() could not generate the neighbor from its address. neighbor =", neighbor);
+				return 5;
+			}
+			
+			// the neighbor gets a pointer back to dat as well. The block cache relies on this to clear every pointer to a block it evicts.
+			dat->neighbors[neighbor] = found;
+			found->neighbors[BLOCK_NEIGHBOR_OPPOSITE(neighbor)] = dat;
+			return 0;
+		}
+	}
+	
 	//--------------------------------------------------
 	// begin the main part of the code.
+	// (this is only used for neighbors that don't have a valid address)
 	//--------------------------------------------------
 	// most of the code is the same for generating neighbors in the up, down, left, and right directions (relative to "dat" block).
 	// there are just occasional if statements that handle minor numerical differences. 
@@ -749,7 +1397,7 @@ short block_generate_neighbor(struct blockData *dat, short neighbor){
 	int ascend = 0;
 	
 	// allocate a chunk of block steps.
-	struct blockStep *stepLink = malloc(sizeof(struct blockStep));
+	struct blockStep *stepLink = block_step_alloc();
 	// verify that stepLink was allocated properly.
 	if(stepLink == NULL){
 		error("block_generate_neighbor() could not allocate memory for stepLink. stepLink = NULL");
@@ -757,6 +1405,7 @@ short block_generate_neighbor(struct blockData *dat, short neighbor){
 	}
 	// this indicates that there is no stepLink before this one. This is the beginning of the linked list of blockSteps.
 	stepLink->prev = NULL;
+	stepLink->next = NULL;
 	
 	// this variable is used to calculate what the last step was. (this is a number that indicates the relationship between the current block (probe) and the previous probe (one of current probe's children)
 	char lastStep;
@@ -770,7 +1419,7 @@ short block_generate_neighbor(struct blockData *dat, short neighbor){
 		// record the child's relation to the parent so that we can know how to get back down to it when we reach the highest necessary parent.
 		lastStep = stepLink->steps[ascend%BLOCK_STEP_SIZE] = probe->parentView;
 		// make sure the parent is generated first
-		block_generate_parent(probe);
+		if(probe->parent == NULL) block_generate_parent(probe);
 		// move up a level to the next parent
 		probe = probe->parent;
 		
@@ -780,17 +1429,19 @@ short block_generate_neighbor(struct blockData *dat, short neighbor){
 		// if we just filled up the current stepLink, then we need to allocate memory for the next
 		if(ascend%BLOCK_STEP_SIZE == 0 && ascend != 0){
 			// allocate more memory to hold more steps
-			stepLink->next = malloc(sizeof(struct blockStep));
+			stepLink->next = block_step_alloc();
 			// check if the memory allocated incorrectly.
 			if(stepLink->next == NULL){
 				// if the memory did not allocate right, report an error.
 				error_d("block_generate_neighbor() could not allocate memory for new stepLink->next. stepLink = NULL. ascend =",ascend);
 				// and return an error.
+				block_step_free(stepLink);
 				return 3;
 			}
 			// otherwise, we will assume the memory was allocated correctly.
 			// record that the previous stepLink (from the next stepLink's point of view) is just the current stepLink.
 			(stepLink->next)->prev = stepLink;
+			(stepLink->next)->next = NULL;
 			// switch to the next stepLink
 			stepLink = stepLink->next;
 		}
@@ -823,9 +1474,10 @@ short block_generate_neighbor(struct blockData *dat, short neighbor){
 	if(ascend%BLOCK_STEP_SIZE == BLOCK_STEP_SIZE-1){
 		// check to make sure the previous stepLink is valid.
 		// this should never EVER be
-		if(stepLink->prev != NULL){
+		if(stepLink->prev == NULL){
 			// This shouldn't happen because ascend should run to 0, and then exit before any stepLink->prev can be NULL. Nevertheless, it has somehow happened. 
 			error_d("block_generate_neighbor() somehow has a NULL stepLink->prev. THIS SHOULD NEVER HAPPEN. ascend =",ascend);
+			block_step_free(stepLink);
 			return 4;
 		}
 		// if the previous stepLink is valid (as it should be) then switch to it.
@@ -834,7 +1486,12 @@ short block_generate_neighbor(struct blockData *dat, short neighbor){
 		// This is like closing the door on the way out of a building.
 		// If you enter a house, then the bathroom, you close the bathroom door on your way out of the bathroom, then you close the house door on your way out of the house.
 		// everything is reverse on the way out.
-		if(stepLink->next != NULL) free(stepLink->next);
+		if(stepLink->next != NULL){
+			// it is cut off from the list first, so block_step_free() only frees that one link.
+			(stepLink->next)->prev = NULL;
+			block_step_free(stepLink->next);
+		}
+		stepLink->next = NULL;
 	}
 	// zoom in once from the highest-level parent to child of that highest-level parent.
 	// the first step of descending is a special case. all the steps after this one are the same.
@@ -853,6 +1510,7 @@ short block_generate_neighbor(struct blockData *dat, short neighbor){
 		probe = probe->children[stepLink->steps[ascend%BLOCK_STEP_SIZE]+1];
 		break;
 	default:
+		block_step_free(stepLink);
 		return -1; // something seriously fucked up has just happened
 	}
 	
@@ -863,9 +1521,10 @@ short block_generate_neighbor(struct blockData *dat, short neighbor){
 		if(ascend%BLOCK_STEP_SIZE == BLOCK_STEP_SIZE-1){
 			// check to make sure the previous stepLink is valid.
 			// this should never EVER be
-			if(stepLink->prev != NULL){
+			if(stepLink->prev == NULL){
 				// This shouldn't happen because ascend should run to 0, and then exit before any stepLink->prev can be NULL. Nevertheless, it has somehow happened. 
 				error_d("block_generate_neighbor() somehow has a NULL stepLink->prev. THIS SHOULD NEVER HAPPEN. ascend =",ascend);
+				block_step_free(stepLink);
 				return 4;
 			}
 			// if the previous stepLink is valid (as it should be) then switch to it.
@@ -874,7 +1533,12 @@ short block_generate_neighbor(struct blockData *dat, short neighbor){
 			// This is like closing the door on the way out of a building.
 			// If you enter a house, then the bathroom, you close the bathroom door on your way out of the bathroom, then you close the house door on your way out of the house.
 			// everything is reverse on the way out.
-			if(stepLink->next != NULL) free(stepLink->next);
+			if(stepLink->next != NULL){
+				// it is cut off from the list first, so block_step_free() only frees that one link.
+				(stepLink->next)->prev = NULL;
+				block_step_free(stepLink->next);
+			}
+			stepLink->next = NULL;
 		}
 		
 		// make sure all children of the current probe block exist
@@ -882,35 +1546,35 @@ short block_generate_neighbor(struct blockData *dat, short neighbor){
 		// then move to the right child
 		switch(neighbor){
 		case BLOCK_NEIGHBOR_UP:
-			probe = probe->children[stepLink->steps[ascend] + 6];
+			probe = probe->children[stepLink->steps[ascend%BLOCK_STEP_SIZE] + 6];
 			break;
 		case BLOCK_NEIGHBOR_DOWN:
-			probe = probe->children[stepLink->steps[ascend] - 6];
+			probe = probe->children[stepLink->steps[ascend%BLOCK_STEP_SIZE] - 6];
 			break;
 		case BLOCK_NEIGHBOR_LEFT:
-			probe = probe->children[stepLink->steps[ascend] + 2];
+			probe = probe->children[stepLink->steps[ascend%BLOCK_STEP_SIZE] + 2];
 			break;
 		case BLOCK_NEIGHBOR_RIGHT:
-			probe = probe->children[stepLink->steps[ascend] - 2];
+			probe = probe->children[stepLink->steps[ascend%BLOCK_STEP_SIZE] - 2];
 			break;
 		default:
+			block_step_free(stepLink);
 			return -1; // something seriously fucked up has just happened
 		}
 	}
 	
+	// all of the steps have been retraced. The list of steps isn't needed any more.
+	block_step_free(stepLink);
+	
 	// store the pointer to the right block in the neighbor pointer array of the block that we initially wanted to know the upwards neighbor of.
+	// the neighbor gets a pointer back to dat as well. The block cache relies on this to clear every pointer to a block it evicts.
 	switch(neighbor){
 	case BLOCK_NEIGHBOR_UP:
-		dat->neighbors[BLOCK_NEIGHBOR_UP] = probe;
-		break;
 	case BLOCK_NEIGHBOR_DOWN:
-		dat->neighbors[BLOCK_NEIGHBOR_DOWN] = probe;
-		break;
 	case BLOCK_NEIGHBOR_LEFT:
-		dat->neighbors[BLOCK_NEIGHBOR_LEFT] = probe;
-		break;
 	case BLOCK_NEIGHBOR_RIGHT:
-		dat->neighbors[BLOCK_NEIGHBOR_RIGHT] = probe;
+		dat->neighbors[neighbor] = probe;
+		probe->neighbors[BLOCK_NEIGHBOR_OPPOSITE(neighbor)] = dat;
 		break;
 	default:
 		return -1; // something seriously fucked up has just happened
@@ -923,145 +1587,3 @@ short block_generate_neighbor(struct blockData *dat, short neighbor){
 	return 0;
 }
 
-
-
-
-
-/// this creates a list of all of the map blocks that have been created during program run time.
-/// this function will record every new map block that is generated.
-/// before the program closes, this function will need to be called to clean up all of these blocks.
-// if operation = bc_collect, then it will collect.
-// returns 0 on success.
-// returns 1 if sent a null block pointer.
-// returns 2 if invalid operation was sent.
-// returns 3 if the function could not create the first link in the list.
-// returns 4 if it could not create a link in the list OTHER than the first.
-// returns 5 if it was asked to bc_clean_up but there was nothing to clean up.
-// returns 6 if it was asked to clean up and it reached a null previous pointer before blockCount reached 0.
-short block_collector(struct blockData *source, short operation){
-	
-	// this tells us how many blocks are allocated in memory
-	static long long int blockCount = 0;
-	// this points to the 
-	static struct blockLink *currentLink = NULL;
-	// used to temporarily store the link pointer
-	struct blockLink *tempLink = NULL;
-	
-	//check to see what the program was called to do.
-	// if the operation is bc_collect
-	if(operation == bc_collect){
-		
-		// check for source pointer being NULL.
-		if(source == NULL){
-			error("block_collector() could not collect source. source = NULL.");
-			return 1;
-		}
-		// if source is valid,
-		else{
-			
-			// check if you need to create a new link in the list.
-			if(blockCount%BLOCK_LINK_SIZE == 0){
-				
-				// if this is the first block added to the list or if the currentLink pointer is invalid,
-				if(blockCount == 0 || currentLink == NULL){
-					// create the first link
-					currentLink = malloc(sizeof(struct blockLink));
-					
-					// check for pointer being NULL.
-					if(currentLink == NULL){
-						error("block_collector() could not create first link in the list. currentLink = NULL.");
-						return 3;
-					}
-					
-					// make sure the previous pointer points to NULL.
-					currentLink->prev = NULL;
-				}
-				// otherwise, if this is not the first block,
-				else{
-					// add a new link in the list
-					currentLink->next = malloc(sizeof(struct blockLink));
-					
-					// check for pointer being NULL.
-					if(currentLink->next == NULL){
-						error_d("block_collector() could not create link in the list. currentLink-> = NULL. blockCount = ", blockCount);
-						return 4;
-					}
-					
-					// make sure the next link points back at the current link.
-					(currentLink->next)->prev = currentLink;
-					// ascend to the next link in the list.
-					currentLink = currentLink->next;
-				}
-				
-			}
-			
-			// add the block to the list
-			currentLink->blocks[blockCount%BLOCK_LINK_SIZE] = source;
-			// increment the block counter.
-			blockCount++;
-			
-		}
-		
-	}
-	else if(operation == bc_clean_up){
-		
-		// check to see if either no blocks have been written or the currentLink was lost.
-		if(currentLink == NULL || blockCount == 0){
-			// set both variables to the default state
-			currentLink = NULL;
-			blockCount = 0;
-			// report an error
-			error("block_collector() asked to clean up. Nothing to clean up. This is not necessarily an error. It could be an error or just a warning.");
-			// and return an error
-			return 5;
-		}
-		
-		gamelog_d("block_collector() cleaning up blocks. blockCount =", blockCount);
-		
-		// decrement to the last valid block
-		blockCount--;
-		
-		// loop through all blocks in all links of the list.
-		// free all blocks and free all of the links in the list.
-		for(; blockCount >= 0; blockCount--){
-			
-			// if the current block is valid,
-			if(currentLink->blocks[blockCount%BLOCK_LINK_SIZE] != NULL){
-				
-				// if the just got to the end of a link,
-				if(blockCount%BLOCK_LINK_SIZE == BLOCK_LINK_SIZE - 1){
-					
-					// if the previous link is invalid,
-					if(currentLink->prev == NULL){
-						error_d("block_collector() has NULL previous link pointer before the end of the list. for() loop terminated with un-erased blocks: blockCount =", blockCount);
-						blockCount = 0;
-						currentLink = NULL;
-						return 6;
-					}
-					
-					// temporarily store the pointer to the currentLink
-					tempLink = currentLink;
-					// shift to the previous link in the list.
-					currentLink = currentLink->prev;
-					// erase free the memory tempLink points to
-					if(tempLink != NULL) free(tempLink);
-				}
-				// erase the memory that holds the block.
-				free(currentLink->blocks[blockCount%BLOCK_LINK_SIZE]);
-			}
-		}
-		
-		// free current link. now everything in the list has been erased (both blocks and links).
-		if(currentLink != NULL) free(currentLink);
-		
-	}
-	// check for invalid operation
-	else{
-		error_d("block_collector() received invalid operation. operation =", operation);
-		return 2;
-	}
-	
-	// all went smoothly. not errors or problems.
-	return 0;
-}
-
@@ -12,6 +12,8 @@
 #define BLOCK_NEIGHBOR_DOWN				1
 #define BLOCK_NEIGHBOR_LEFT				2
 #define BLOCK_NEIGHBOR_RIGHT			3
+// this gives the direction that points back the other way (up <-> down, left <-> right)
+#define BLOCK_NEIGHBOR_OPPOSITE(n)		((n)^1)
 
 // this describes how much a line is scaled when you go from one level to another.
 // this is a LINEAR scale factor, meaning, the same distance looks three times as long when you zoom in once.
@@ -25,6 +27,10 @@
 #define BLOCK_WIDTH_2_3					162
 #define BLOCK_HEIGHT_1_3				81
 #define BLOCK_HEIGHT_2_3				162
+// blocks are split up into square tiles this big to keep track of which parts of them need to be rendered again (see block_mark_dirty()).
+#define BLOCK_TILE_SIZE					27
+#define BLOCK_TILES_X					(BLOCK_WIDTH/BLOCK_TILE_SIZE)
+#define BLOCK_TILES_Y					(BLOCK_HEIGHT/BLOCK_TILE_SIZE)
 
 // this is the default elevation for all blocks. This shouldn't even be necessary. Eventually, every block will be generated with terrain specific to its zoom level and position on the map.
 #define BLOCK_DEFAULT_ELEVATION			0.0f
@@ -50,6 +56,16 @@
 // I don't know when I will ever use this
 #define BLOCK_CHILD_INVALID				10
 
+// blocks with an addressX or addressY bigger than this (or smaller than the negative of this) can't have children with valid addresses.
+// it is a little less than LLONG_MAX/3 so that 3*x+1 never overflows.
+#define BLOCK_ADDRESS_MAX				3000000000000000000LL
+
+// these are the return values of block_locate().
+#define BLOCK_LOCATE_FOUND				0
+#define BLOCK_LOCATE_NEED_CHILDREN		1
+#define BLOCK_LOCATE_NEED_PARENT		2
+#define BLOCK_LOCATE_INVALID			3
+
 //	0 1 2
 //	3 4 5
 //	6 7 8
@@ -82,6 +98,20 @@ struct blockData{
 	// if parentView = 8, then the parent of this block sees this block in its lower right position.
 	char parentView;
 	
+	// this is 1 if the block is concentric with the origin (the origin, its parents, and its center children all the way down). Otherwise it is 0.
+	char concentric;
+	// this is the seed that the block's elevation data is generated from.
+	// it only depends on the world seed, the level, and the path of parentView's from the nearest concentric block above this one.
+	// so the same block always gets the same seed, no matter what order the blocks were generated in.
+	unsigned long long seed;
+	
+	// this is where the block is on its level (see "Block Addresses" below).
+	// the concentric block on every level is at (0,0). x goes right and y goes down, one unit per block.
+	// the child c of the block at (X,Y) is at (3X + c%3 - 1, 3Y + c/3 - 1).
+	long long addressX, addressY;
+	// this is 1 if addressX and addressY are valid. It is 0 if the block is so far down that its address doesn't fit in a long long.
+	char addressValid;
+	
 	// these are pointers to child blocks.
 	// these are pointers to other blocks inside of this main block.
 	// each block will be split up into BLOCK_CHILDREN smaller ones.
@@ -90,24 +120,42 @@ struct blockData{
 	
 	// these are eight pointers to the four neighbors on the same level (up, down, left, and right
 	// if these are NULL, the neighbor could exist, but it just might not be entered in this blocks neighbor's index (some neighbors are friendly than others :P)
+	// neighbor links are always made in both directions. If A->neighbors[BLOCK_NEIGHBOR_UP] is B, then B->neighbors[BLOCK_NEIGHBOR_DOWN] is A.
 	struct blockData *neighbors[BLOCK_NEIGHBORS];
 	
-	// this NEEDS to be set to NULL when you create a new block.
-	// this is an image of the block elevation data.
-	// it is rendered at 1 pixel per element in the elevation array. (so it is BLOCK_WIDTH by BLOCK_HEIGHT).
-	// this is used to store rendered images of the texture's elevation.
-	SDL_Texture *texture;
+	// the rendered image of the block is kept in the texture cache (see texture_cache.h), not in the block.
+	// this is the entry in the texture cache that holds the block's image. The cache checks that the entry still belongs to this block before it uses it, so an old value is harmless.
+	int textureEntry;
+	
+	// this keeps track of which parts of the block need to be rendered again (the block is split up into BLOCK_TILES_X x BLOCK_TILES_Y tiles).
+	// bit x of dirtyTiles[y] is set when the tile in column x and row y of tiles has changed since the block was last rendered.
+	/// IF YOU CHANGE ANYTHING IN THE ELEVATION DATA, MARK THE PART YOU CHANGED WITH block_mark_dirty() (or the whole thing with block_mark_all_dirty()).
+	// new blocks are all dirty (so that they are rendered for the first time).
+	// block_render() only converts and uploads the dirty tiles, and then clears them.
+	// so a small edit only costs a small upload. The program does not need to render the same thing over and over each frame of the game.
+	unsigned short dirtyTiles[BLOCK_TILES_Y];
+	
+	// this is the slot that this block occupies in the block pool.
+	// it is set by block_pool_alloc() and is used by block_pool_free() to give the slot back.
+	long long poolIndex;
+	
+	// this is the last frame that this block was used in (see block_cache_touch()).
+	// the block cache evicts the blocks that have gone the longest without being used.
+	unsigned long lastTouched;
+	// this is how many times the block has been pinned. A pinned block is never evicted by the block cache.
+	short pins;
 	
-	// this is a flag that tells the graphics functions when they need to re-render the block.
-	/// THIS NEEDS TO BE SET TO 1 TO TELL THE GRAPHICS FUNCTION TO RE RENDER IF YOU CHANGE ANYTHING IN THE ELEVATION DATA YOU GODDAMN BITCH.
-	// also set this to 1 when you create a new block (so that it can be rendered for the first time).
-	// when this is set to 1, the graphics functions will re-render the block's texture.
-	// Said graphics functions will reset this flag to 0 when they have rendered it (so rendering is minimized and only done when needed).
-	// the program does not need to render the same thing over and over each frame of the game.
-	// just render it once, and let the hardware do the rest.
-	char renderMe;
+	// this is 1 if the block's elevation has been built from its children (see block_mip.h).
+	char mipBuilt;
+	// bit c of this is set when child c was evicted after it had been built from its own children (see block_cache.h).
+	// when that child is generated again, it is built from its children again (so it looks the same), and the bit is cleared.
+	// a block with any of these bits set is mip-locked. The block cache never evicts it (it would forget which children to build), and it isn't built from its children while any of the bits are still set.
+	unsigned short mipLocked;
+	// this is 1 if the user has changed the block's elevation. The block cache never evicts an edited block, because generating it again would lose the changes.
+	char edited;
 	
 	// this is the two dimensional array of elevation values for each block.
+	// once a block has children, this is built from the children's elevation (see block_mip.h).
 	float elevation[BLOCK_WIDTH][BLOCK_HEIGHT];
 	
 };
@@ -157,6 +205,17 @@ FOR EVERY PARENT THAT IS GENERATED, IT WILL BE CONCENTRIC WITH THE ORIGIN.
 The above fact is crucial to understand. It is one of the most important and useful facts about this system.
 
 
+//--------------------------------------------------
+// Block Addresses
+//--------------------------------------------------
+Every block has an address: its level and its (x,y) position on that level.
+Because every parent is concentric with the origin, the concentric block on each level is at (0,0).
+The children of the block at (X,Y) are at (3X-1, 3Y-1) through (3X+1, 3Y+1), so the parent of (x,y) is at (floor((x+1)/3), floor((y+1)/3)).
+The neighbors of (x,y) are just (x,y-1), (x,y+1), (x-1,y), and (x+1,y).
+Every block with a valid address is in the block index (see block_index.h), so any block can be found from its address without walking the network.
+The coordinates get three times bigger with every level down, so below about 39 levels under the origin they don't fit in a long long any more.
+Those blocks are flagged with addressValid = 0 and their neighbors are found by walking the network instead.
+
 //--------------------------------------------------
 // FAQ
 //--------------------------------------------------
@@ -168,19 +227,6 @@ A.	If the user wants to pan around horizontally on the same level, the program w
 */
 
 
-#define BLOCK_LINK_SIZE 256
-/// this is a linked list of arrays of pointers to blockData structures.
-// this structure is here simply to facilitate garbage collection.
-// there is a function that collects pointers to all of the blocks generated.
-// when this program is terminated, every block on that list will be erased and the memory is freed.
-struct blockLink{
-	// a pointer to the previous blockLink in the list
-	struct blockLink *prev;
-	struct blockData *blocks[BLOCK_LINK_SIZE];
-	struct blockLink *next;
-};
-
-
 #define BLOCK_STEP_SIZE 256
 /// this is a linked list of steps taken when ascending the network.
 // this is mainly used when generating/verifying neighbors.
@@ -194,19 +240,35 @@ struct blockStep{
 };
 
 
-/// these are definitions for the block_collector program.
-// the function will either be collecting a list of all map blocks being generated (as they are generated)
-// or the function will de-allocate (free) all of the data it has collected so far.
-#define bc_collect		0
-#define bc_clean_up		1
-short block_collector(struct blockData *block, short operation);
 
 
+void block_set_world_seed(unsigned long long worldSeed);
+unsigned long long block_get_world_seed();
+unsigned long long block_seed_concentric(signed long long level);
 
 struct blockData *block_generate_origin();
 short block_generate_children(struct blockData *datParent);
 short block_generate_parent(struct blockData *centerChild);
 short block_generate_neighbor(struct blockData *dat, short neighbor);
+long long block_address_up(long long v);
+short block_locate(signed long long level, long long x, long long y, struct blockData **block);
+struct blockData *block_generate_address(signed long long level, long long x, long long y);
+
+// these split generation up into building (the slow part, which doesn't need the block lock) and publishing (linking the new blocks into the network, which does).
+struct blockData *block_build_parent(struct blockData *centerChild);
+short block_publish_parent(struct blockData *centerChild, struct blockData *newParent, struct blockData *siblings[BLOCK_CHILDREN]);
+short block_build_children(struct blockData *datParent, struct blockData *children[BLOCK_CHILDREN]);
+int block_publish_children(struct blockData *datParent, struct blockData *children[BLOCK_CHILDREN]);
+
+short block_lock_init();
+void block_lock_quit();
+void block_lock();
+void block_unlock();
+void block_graph_changed();
+unsigned long block_graph_version();
+struct blockData *block_top();
+long long block_step_allocated_count();
+long long block_step_live_count();
 
 
 short map_print(SDL_Surface *dest, struct blockData *block);
@@ -226,7 +288,10 @@ short block_print_to_file(struct blockData *block, char *fileName);
 
 
 short block_print_network_hierarchy(SDL_Surface *dest, struct blockData *focus, struct blockData *highlight, unsigned int childLevelsOrig, unsigned int childLevels, int x, int y, int size, Uint32 colorTop, Uint32 colorBot, Uint32 colorHighlight);
-short block_render(struct blockData *block, SDL_Renderer *blockRenderer);
+short block_render(struct blockData *block, SDL_Texture *texture);
+void block_mark_dirty(struct blockData *block, int x0, int y0, int x1, int y1);
+void block_mark_all_dirty(struct blockData *block);
+char block_is_dirty(struct blockData *block);
 
 short block_smooth(struct blockData *block, float smoothFactor);
 float block_surrounding_average(struct blockData *block, unsigned int x, unsigned int y);
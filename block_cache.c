@@ -0,0 +1,243 @@
+#include "block.h"
+#include "block_cache.h"
+#include "block_pool.h"
+#include "block_index.h"
+#include "texture_cache.h"
+#include <stdlib.h>
+#include "utilities.h"
+
+
+// this is the maximum number of blocks allowed in memory. 0 means there is no limit.
+static long long maxBlocks = BLOCK_CACHE_DEFAULT_MAX_BLOCKS;
+// this is the current frame. it is used to stamp blocks when they are used.
+static unsigned long frame = 1;
+// this is how many blocks have been evicted since the program started.
+static long long evictedCount = 0;
+// when nothing could be evicted, this is how many blocks there were (-1 means the cache isn't stuck), and what frame it was.
+// the cache doesn't look again until the number of blocks changes, the budget changes, or BLOCK_CACHE_STUCK_RETRY_FRAMES have gone by (blocks that were in use might not be anymore).
+static long long stuckCount = -1;
+static unsigned long stuckFrame = 0;
+
+
+/// this is a set of 9 sibling blocks that may be evicted (identified by their parent).
+struct blockCacheCandidate{
+	struct blockData *parent;
+	// this is the most recent frame that any of the siblings was used in.
+	unsigned long lastTouched;
+};
+
+
+
+/// this sets the maximum number of blocks that will be kept in memory.
+// 0 (or less) means that blocks will never be evicted.
+void block_cache_set_max_blocks(long long max){
+	if(max < 0) max = 0;
+	maxBlocks = max;
+	stuckCount = -1;
+	gamelog_d("block_cache_set_max_blocks() set maxBlocks =", (int)maxBlocks);
+}
+
+
+
+/// this sets the maximum number of bytes of blocks that will be kept in memory.
+// the budget is rounded down to a whole number of blocks (but it is always at least one set of children).
+void block_cache_set_max_bytes(long long maxBytes){
+	if(maxBytes <= 0){
+		block_cache_set_max_blocks(0);
+		return;
+	}
+	long long max = maxBytes/sizeof(struct blockData);
+	if(max < BLOCK_CHILDREN) max = BLOCK_CHILDREN;
+	block_cache_set_max_blocks(max);
+}
+
+
+
+/// returns the maximum number of blocks that will be kept in memory (0 means no limit).
+long long block_cache_get_max_blocks(){
+	return maxBlocks;
+}
+
+
+
+/// this moves the cache on to the next frame.
+// call this once at the beginning of each frame.
+// blocks touched during the current frame are never evicted.
+void block_cache_tick(){
+	frame++;
+}
+
+
+
+/// this records that a block was just used.
+// the camera touches its target every time it is checked or rendered.
+void block_cache_touch(struct blockData *block){
+	if(block == NULL) return;
+	block->lastTouched = frame;
+}
+
+
+
+/// a pinned block is never evicted (and neither are its siblings).
+// pins are counted, so every block_cache_pin() needs a matching block_cache_unpin().
+void block_cache_pin(struct blockData *block){
+	if(block == NULL){
+		error("block_cache_pin() was sent NULL block. block = NULL");
+		return;
+	}
+	block->pins++;
+}
+
+
+
+/// this removes one pin from a block.
+void block_cache_unpin(struct blockData *block){
+	if(block == NULL){
+		error("block_cache_unpin() was sent NULL block. block = NULL");
+		return;
+	}
+	if(block->pins <= 0){
+		error("block_cache_unpin() was asked to unpin a block that is not pinned.");
+		return;
+	}
+	block->pins--;
+}
+
+
+
+/// this checks to see if the children of "parent" can be evicted.
+// returns 1 if all 9 children exist, none of them have children of their own, none of them are pinned, edited, or mip-locked, and none of them were used this frame.
+// returns 0 otherwise.
+static short block_cache_evictable(struct blockData *parent, unsigned long *lastTouched){
+
+	int c;
+	*lastTouched = 0;
+	for(c=0; c<BLOCK_CHILDREN; c++){
+		struct blockData *child = parent->children[c];
+		if(child == NULL) return 0;
+		// children are generated all or none, so checking the first grandchild is enough.
+		if(child->children[0] != NULL) return 0;
+		if(child->pins > 0) return 0;
+		if(child->edited) return 0;
+		// a mip-locked child would forget which of its children have to be built from their own children (see blockData.mipLocked).
+		if(child->mipLocked) return 0;
+		if(child->lastTouched >= frame) return 0;
+		if(child->lastTouched > *lastTouched) *lastTouched = child->lastTouched;
+	}
+	return 1;
+}
+
+
+
+/// this is used by qsort() to put the least recently used candidates first.
+static int block_cache_compare(const void *a, const void *b){
+	unsigned long ta = ((const struct blockCacheCandidate *)a)->lastTouched;
+	unsigned long tb = ((const struct blockCacheCandidate *)b)->lastTouched;
+	if(ta < tb) return -1;
+	if(ta > tb) return 1;
+	return 0;
+}
+
+
+
+/// this evicts all 9 children of parent.
+// every pointer to the children (from the parent, from their neighbors, and from the block index) is removed before the children are freed.
+// the parent remembers which of the children were built from children of their own (see blockData.mipLocked), so they are built the same way when they are generated again.
+static void block_cache_evict_children(struct blockData *parent){
+
+	int c, n;
+	for(c=0; c<BLOCK_CHILDREN; c++){
+		struct blockData *child = parent->children[c];
+		if(child->mipBuilt) parent->mipLocked |= 1 << c;
+
+		// neighbor links are always made in both directions, so each neighbor that points back at the child can be found from the child.
+		for(n=0; n<BLOCK_NEIGHBORS; n++){
+			struct blockData *neighbor = child->neighbors[n];
+			if(neighbor != NULL && neighbor->neighbors[BLOCK_NEIGHBOR_OPPOSITE(n)] == child){
+				neighbor->neighbors[BLOCK_NEIGHBOR_OPPOSITE(n)] = NULL;
+			}
+			child->neighbors[n] = NULL;
+		}
+
+		// give the child's rendered image back to the texture cache
+		texture_cache_release(child);
+
+		parent->children[c] = NULL;
+		block_index_remove(child);
+		block_pool_free(child);
+		evictedCount++;
+	}
+	block_graph_changed();
+}
+
+
+
+/// this will evict the least recently used blocks until the number of blocks in memory is within the budget.
+// call this once per frame (after the camera has been checked and rendered).
+// returns 0 on success (or when there is nothing to do)
+// returns 1 if the candidate list could not be allocated
+// returns 2 if the budget could not be met because there was nothing left that could be evicted
+short block_cache_evict(){
+
+	if(maxBlocks <= 0 || block_pool_count() <= maxBlocks){
+		stuckCount = -1;
+		return 0;
+	}
+	// the budget couldn't be met last time, and nothing has been added or freed since then (see stuckCount).
+	if(block_pool_count() == stuckCount && frame - stuckFrame < BLOCK_CACHE_STUCK_RETRY_FRAMES) return 2;
+
+	// this is the number of blocks the cache will evict down to.
+	long long lowWater = (maxBlocks*BLOCK_CACHE_LOW_WATER_PERCENT)/100;
+
+	while(block_pool_count() > lowWater){
+
+		// every candidate is the parent of 9 children, so there can't be more than this many.
+		long long maxCandidates = block_pool_count()/BLOCK_CHILDREN + 1;
+		struct blockCacheCandidate *candidates = malloc(maxCandidates*sizeof(struct blockCacheCandidate));
+		if(candidates == NULL){
+			error("block_cache_evict() could not allocate memory for the candidate list. candidates = NULL");
+			return 1;
+		}
+
+		// find every set of children that could be evicted
+		long long i, candidateCount = 0;
+		unsigned long lastTouched;
+		for(i=0; i<block_pool_capacity(); i++){
+			struct blockData *block = block_pool_slot(i);
+			if(block == NULL || block->children[0] == NULL) continue;
+			if(block_cache_evictable(block, &lastTouched) && candidateCount < maxCandidates){
+				candidates[candidateCount].parent = block;
+				candidates[candidateCount].lastTouched = lastTouched;
+				candidateCount++;
+			}
+		}
+
+		if(candidateCount == 0){
+			free(candidates);
+			// this is only logged when the cache first gets stuck. It stays stuck (quietly) until something changes.
+			if(stuckCount < 0) gamelog_d("block_cache_evict() could not find any blocks to evict. The budget is too small for the blocks in use. block_pool_count() =", (int)block_pool_count());
+			stuckCount = block_pool_count();
+			stuckFrame = frame;
+			return 2;
+		}
+
+		// evict the oldest sets of children first.
+		// evicting children can turn their parent into a leaf, so the loop goes around again to find those.
+		qsort(candidates, candidateCount, sizeof(struct blockCacheCandidate), block_cache_compare);
+		for(i=0; i<candidateCount && block_pool_count() > lowWater; i++){
+			block_cache_evict_children(candidates[i].parent);
+		}
+
+		free(candidates);
+	}
+
+	stuckCount = -1;
+	return 0;
+}
+
+
+
+/// returns the number of blocks that have been evicted since the program started.
+long long block_cache_evicted_count(){
+	return evictedCount;
+}
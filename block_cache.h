@@ -0,0 +1,33 @@
+//#include "block.h"
+
+/// block cache definitions
+// the block cache keeps the number of blocks in memory under a budget.
+// when there are too many blocks, the least recently used blocks are evicted (freed) and they will be re-generated if the user comes back to them.
+// blocks are evicted a whole set of 9 siblings at a time so that every block still has either all of its children or none of them.
+// only siblings that have no children of their own can be evicted. The parent stays in the network so the siblings can be found (generated) again.
+// siblings that the user has edited are never evicted (their changes can't be generated again).
+// a block that is generated again gets the same random elevation it had before, but a block that was built from its children (see block_mip.h) has to be built from them again.
+// so when a sibling that was built from its children is evicted, its parent is mip-locked (see blockData.mipLocked). When the sibling is generated again, its children are made just long enough to build it.
+// that only works if those children were random noise themselves. So a mip-locked block is never evicted: its children had children of their own.
+// the same world always looks the same, no matter what was evicted.
+
+// this is the default maximum number of blocks in memory. Each block is about 236 kB, so this is about 240 MB.
+#define BLOCK_CACHE_DEFAULT_MAX_BLOCKS		1024
+// when the budget is exceeded, the cache evicts blocks until there are only this percentage of the budget left.
+// this keeps the cache from having to evict a few blocks every single frame.
+#define BLOCK_CACHE_LOW_WATER_PERCENT		90
+// when there is nothing that can be evicted, the cache waits this many frames before it looks again (unless the number of blocks changes).
+#define BLOCK_CACHE_STUCK_RETRY_FRAMES		60
+
+
+void block_cache_set_max_blocks(long long maxBlocks);
+void block_cache_set_max_bytes(long long maxBytes);
+long long block_cache_get_max_blocks();
+
+void block_cache_tick();
+void block_cache_touch(struct blockData *block);
+void block_cache_pin(struct blockData *block);
+void block_cache_unpin(struct blockData *block);
+
+short block_cache_evict();
+long long block_cache_evicted_count();
@@ -0,0 +1,170 @@
+#include "block.h"
+#include "block_index.h"
+#include <stdlib.h>
+#include "rand.h"
+#include "utilities.h"
+
+
+// this is the table of blocks. Empty slots are NULL.
+static struct blockData **indexTable = NULL;
+// this is how many slots are in the table (always a power of two, or 0 before the first insert).
+static long long indexSize = 0;
+// this is how many blocks are in the table.
+static long long indexCount = 0;
+
+
+
+/// this returns the slot that a block with this address would like to be in.
+static long long block_index_home(signed long long level, long long x, long long y){
+	unsigned long long hash = rand_combine(rand_combine((unsigned long long)level, (unsigned long long)x), (unsigned long long)y);
+	return (long long)(hash & (unsigned long long)(indexSize-1));
+}
+
+
+
+/// this puts a block into the table without checking the load or for duplicates.
+static void block_index_place(struct blockData *block){
+	long long slot = block_index_home(block->level, block->addressX, block->addressY);
+	while(indexTable[slot] != NULL){
+		slot = (slot+1) & (indexSize-1);
+	}
+	indexTable[slot] = block;
+}
+
+
+
+/// this makes the table bigger and puts every block back into it.
+// returns 0 on success
+// returns 1 if the new table could not be allocated
+static short block_index_grow(){
+
+	long long newSize = indexSize ? indexSize*2 : BLOCK_INDEX_INITIAL_SIZE;
+	struct blockData **newTable = calloc(newSize, sizeof(struct blockData *));
+	if(newTable == NULL){
+		error_d("block_index_grow() could not allocate a bigger table. newSize =", (int)newSize);
+		return 1;
+	}
+
+	struct blockData **oldTable = indexTable;
+	long long oldSize = indexSize;
+	indexTable = newTable;
+	indexSize = newSize;
+
+	long long s;
+	for(s=0; s<oldSize; s++){
+		if(oldTable[s] != NULL) block_index_place(oldTable[s]);
+	}
+	free(oldTable);
+
+	return 0;
+}
+
+
+
+/// this adds a block to the index.
+// returns 0 on success
+// returns 1 on NULL block
+// returns 2 if the block does not have a valid address
+// returns 3 if the index could not grow
+// returns 4 if there is already a block with the same address in the index
+short block_index_insert(struct blockData *block){
+
+	if(block == NULL){
+		error("block_index_insert() was sent NULL block. block = NULL");
+		return 1;
+	}
+	if(!block->addressValid) return 2;
+
+	if((indexCount+1)*100 > indexSize*BLOCK_INDEX_MAX_LOAD_PERCENT){
+		if(block_index_grow()) return 3;
+	}
+
+	if(block_index_find(block->level, block->addressX, block->addressY) != NULL){
+		error_d("block_index_insert() was asked to insert a second block at the same address. level =", (int)block->level);
+		return 4;
+	}
+
+	block_index_place(block);
+	indexCount++;
+
+	return 0;
+}
+
+
+
+/// this takes a block out of the index.
+// the blocks after it in the same run of full slots are shifted back so that they can still be found.
+// returns 0 on success
+// returns 1 on NULL block
+// returns 2 if the block was not in the index
+short block_index_remove(struct blockData *block){
+
+	if(block == NULL){
+		error("block_index_remove() was sent NULL block. block = NULL");
+		return 1;
+	}
+	if(!block->addressValid || indexSize == 0) return 2;
+
+	// find the slot the block is in
+	long long slot = block_index_home(block->level, block->addressX, block->addressY);
+	while(indexTable[slot] != block){
+		if(indexTable[slot] == NULL) return 2;
+		slot = (slot+1) & (indexSize-1);
+	}
+	indexTable[slot] = NULL;
+	indexCount--;
+
+	// shift back every block after the hole that would not be found anymore because of it.
+	long long hole = slot;
+	long long next = (slot+1) & (indexSize-1);
+	while(indexTable[next] != NULL){
+		long long home = block_index_home(indexTable[next]->level, indexTable[next]->addressX, indexTable[next]->addressY);
+		// the block can move into the hole if its home is not in the (circular) range between the hole and where it is now.
+		long long fromHome = (next - home) & (indexSize-1);
+		long long fromHole = (next - hole) & (indexSize-1);
+		if(fromHome >= fromHole){
+			indexTable[hole] = indexTable[next];
+			indexTable[next] = NULL;
+			hole = next;
+		}
+		next = (next+1) & (indexSize-1);
+	}
+
+	return 0;
+}
+
+
+
+/// returns the block at the address (level, x, y).
+// returns NULL if there is no block at that address in the index.
+struct blockData *block_index_find(signed long long level, long long x, long long y){
+
+	if(indexSize == 0) return NULL;
+
+	long long slot = block_index_home(level, x, y);
+	while(indexTable[slot] != NULL){
+		struct blockData *block = indexTable[slot];
+		if(block->level == level && block->addressX == x && block->addressY == y) return block;
+		slot = (slot+1) & (indexSize-1);
+	}
+
+	return NULL;
+}
+
+
+
+/// returns the number of blocks in the index.
+long long block_index_count(){
+	return indexCount;
+}
+
+
+
+/// this throws away the whole index.
+// call this when the blocks are cleaned up (see block_pool_clean_up()).
+void block_index_clean_up(){
+	free(indexTable);
+	indexTable = NULL;
+	indexSize = 0;
+	indexCount = 0;
+}
@@ -0,0 +1,19 @@
+//#include "block.h"
+
+/// block index definitions
+// the block index is a hash table that finds a block from its address (level, addressX, addressY).
+// every block in the network that has a valid address is in the index (blocks are added when they are published and removed when they are evicted).
+// the table uses open addressing with linear probing. When a block is removed, the blocks after it are shifted back so there are never any "deleted" markers in the table.
+// the block lock needs to be held whenever the index is used (see block_lock()).
+
+// this is how many slots the index starts out with. It has to be a power of two.
+#define BLOCK_INDEX_INITIAL_SIZE		1024
+// the index doubles in size when it gets more than this percent full.
+#define BLOCK_INDEX_MAX_LOAD_PERCENT	50
+
+
+short block_index_insert(struct blockData *block);
+short block_index_remove(struct blockData *block);
+struct blockData *block_index_find(signed long long level, long long x, long long y);
+long long block_index_count();
+void block_index_clean_up();
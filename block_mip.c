@@ -0,0 +1,138 @@
+#include "block.h"
+#include "block_mip.h"
+#include <SDL2/SDL.h>
+#include "utilities.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+
+/// this adds three columns of elevation together (count elements of each) and puts the result in sum.
+// with SSE2, four elements of each column are added at once. The additions are done in the same order either way, so the result is the same.
+static void block_mip_sum_columns(const float *a, const float *b, const float *c, float *sum, int count){
+	int y = 0;
+#ifdef __SSE2__
+	for(; y+4<=count; y+=4){
+		_mm_storeu_ps(sum+y, _mm_add_ps(_mm_add_ps(_mm_loadu_ps(a+y), _mm_loadu_ps(b+y)), _mm_loadu_ps(c+y)));
+	}
+#endif
+	for(; y<count; y++){
+		sum[y] = a[y] + b[y] + c[y];
+	}
+}
+
+
+
+/// this builds the elements [x0,x1) x [y0,y1) of parent from the children under them (children[c] is the child in position c).
+// every element of the parent is the average of the 3x3 elements of the child under it.
+// the children are read one column at a time (the way elevation[][] is stored): three columns of the child are added together, and then every three elements of the sum become one element of the parent.
+static void block_mip_reduce(struct blockData *parent, struct blockData *children[BLOCK_CHILDREN], int x0, int y0, int x1, int y1){
+
+	// this holds the sum of three columns of one child
+	float sum[BLOCK_HEIGHT];
+	int x, y, k;
+
+	for(x=x0; x<x1; x++){
+		// this is the column of children, and the first of the three columns of the child that are under x.
+		int cx = x/BLOCK_WIDTH_1_3;
+		int childX = (x - cx*BLOCK_WIDTH_1_3)*3;
+
+		y = y0;
+		while(y < y1){
+			// the column of the parent might go over more than one child
+			int cy = y/BLOCK_HEIGHT_1_3;
+			int yEnd = (cy+1)*BLOCK_HEIGHT_1_3;
+			if(yEnd > y1) yEnd = y1;
+			struct blockData *child = children[cx + 3*cy];
+			int childY = (y - cy*BLOCK_HEIGHT_1_3)*3;
+
+			block_mip_sum_columns(&child->elevation[childX][childY], &child->elevation[childX+1][childY], &child->elevation[childX+2][childY], sum, (yEnd - y)*3);
+			for(k=0; y<yEnd; y++, k+=3){
+				parent->elevation[x][y] = (sum[k] + sum[k+1] + sum[k+2])*(1.0f/9.0f);
+			}
+		}
+	}
+}
+
+
+
+/// this builds all of the elevation of parent from its nine children.
+// this is called when the children are published. The parent's own random elevation is replaced.
+// returns 0 on success
+// returns 1 on NULL parent
+// returns 2 if the parent doesn't have all of its children
+short block_mip_build(struct blockData *parent){
+
+	if(parent == NULL){
+		error("block_mip_build() was sent NULL parent. parent = NULL");
+		return 1;
+	}
+	return block_mip_build_from(parent, parent->children);
+}
+
+
+
+/// this builds all of the elevation of parent from the nine blocks in children[] (children[c] goes where child c of parent would go).
+// the children don't have to be linked into parent. This is how a block that is being built again is made from children that are only made long enough to build it (see block_cache.h).
+// if parent hasn't been published yet, this doesn't need the block lock.
+// returns 0 on success
+// returns 1 on NULL parent or children
+// returns 2 if one of the children is NULL
+short block_mip_build_from(struct blockData *parent, struct blockData *children[BLOCK_CHILDREN]){
+
+	if(parent == NULL || children == NULL){
+		error("block_mip_build_from() was sent NULL parent or children.");
+		return 1;
+	}
+	int c;
+	for(c=0; c<BLOCK_CHILDREN; c++){
+		if(children[c] == NULL){
+			error_d("block_mip_build_from() was sent a parent that is missing a child. child =", c);
+			return 2;
+		}
+	}
+
+	block_mip_reduce(parent, children, 0, 0, BLOCK_WIDTH, BLOCK_HEIGHT);
+	block_mark_all_dirty(parent);
+	parent->mipBuilt = 1;
+	return 0;
+}
+
+
+
+/// this builds the part of each of block's ancestors that shows block again.
+// call this after the elevation of a block changes (and after its parent is built, see block_mip_build()).
+// it stops at an ancestor that the user has edited. That ancestor keeps its changes, so nothing above it changes either.
+// the part that needs to be built shrinks by 3 with every level up (81x81 of the parent, 27x27 of the grandparent, and so on), so this is much cheaper than building the ancestors over again.
+// returns 0 on success
+// returns 1 on NULL block
+short block_mip_update(struct blockData *block){
+
+	if(block == NULL){
+		error("block_mip_update() was sent NULL block. block = NULL");
+		return 1;
+	}
+
+	// this is the part of block that changed
+	int x0 = 0, y0 = 0, x1 = BLOCK_WIDTH, y1 = BLOCK_HEIGHT;
+
+	while(block->parent != NULL && !block->parent->edited){
+		struct blockData *parent = block->parent;
+		// this is where block is inside of its parent
+		int offsetX = (block->parentView%3)*BLOCK_WIDTH_1_3;
+		int offsetY = (block->parentView/3)*BLOCK_HEIGHT_1_3;
+		// this is the part of the parent that shows the part of block that changed (rounded out to whole elements)
+		x0 = offsetX + x0/3;
+		y0 = offsetY + y0/3;
+		x1 = offsetX + (x1+2)/3;
+		y1 = offsetY + (y1+2)/3;
+
+		block_mip_reduce(parent, parent->children, x0, y0, x1, y1);
+		// only the part that was built needs to be rendered again
+		block_mark_dirty(parent, x0, y0, x1, y1);
+		block = parent;
+	}
+
+	return 0;
+}
@@ -0,0 +1,16 @@
+//#include "block.h"
+
+/// block mip definitions
+// a block that has children doesn't show its own random elevation. Its elevation is a smaller copy of its nine children (a mipmap).
+// each element of the parent is the average of the 3x3 elements of the child under it (so the 729x729 elements of the children become the 243x243 of the parent).
+// so when the camera zooms out, the parent looks exactly like the children it was just looking at, only smaller.
+// the parent is built when its children are published (see block_publish_children() and block_publish_parent()).
+// when a block's elevation changes, only the part of each ancestor that shows that block is built again (see block_mip_update()).
+// a block the user has edited is never built from its children, so the changes stay.
+// when a child that was built from its own children is evicted, it is built the same way again when it is generated again (see block_cache.h), so the same world always looks the same.
+// the block lock needs to be held whenever these are used (see block_lock()).
+
+
+short block_mip_build(struct blockData *parent);
+short block_mip_build_from(struct blockData *parent, struct blockData *children[BLOCK_CHILDREN]);
+short block_mip_update(struct blockData *block);
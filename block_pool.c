@@ -0,0 +1,301 @@
+#include "block.h"
+#include "block_pool.h"
+#include <SDL2/SDL.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include "utilities.h"
+
+
+/// this is one slab of blocks.
+// every block in the program lives inside one of these.
+// live[] records which of the blocks in the slab are currently handed out.
+struct blockSlab{
+	struct blockData blocks[BLOCK_POOL_SLAB_SIZE];
+	char live[BLOCK_POOL_SLAB_SIZE];
+};
+
+
+// this is an array of pointers to all of the slabs that have been allocated.
+static struct blockSlab **slabs = NULL;
+// this is how many slabs have been allocated.
+static long long slabCount = 0;
+// this is how many slab pointers the slabs array can hold before it needs to grow.
+static long long slabArraySize = 0;
+
+// this is a stack of pool indexes that are free to be handed out.
+static long long *freeList = NULL;
+// this is how many indexes are on the free list.
+static long long freeCount = 0;
+
+// this is how many blocks are currently handed out.
+static long long liveCount = 0;
+// this is how many blocks have been handed out since the program started (it never goes down).
+static long long allocatedCount = 0;
+
+// this protects the pool when blocks are allocated and freed from more than one thread at a time.
+// allocating and freeing are very quick, so a spin lock is good enough.
+// nothing slow (malloc, realloc, or logging) is ever done while it is held. block_pool_grow() allocates its memory before it takes the lock.
+static SDL_SpinLock poolLock = 0;
+
+
+
+/// this allocates one more slab and puts all of its blocks on the free list.
+// the slab (and bigger slab and free list arrays, if they are needed) are allocated without holding poolLock, so other threads can keep allocating and freeing while the memory is found.
+// the lock is only taken to swap the new memory in.
+// if another thread already refilled the free list while this one was allocating, the new slab is not needed and it is freed again.
+// returns 0 on success (this includes the case where another thread grew the pool first)
+// returns 1 if the slab array could not grow
+// returns 2 if the slab could not be allocated
+// returns 3 if the free list could not grow
+static short block_pool_grow(){
+
+	// look at how big the pool is right now. This is only used to decide how much memory to allocate.
+	SDL_AtomicLock(&poolLock);
+	long long arraySize = slabArraySize;
+	long long count = slabCount;
+	SDL_AtomicUnlock(&poolLock);
+
+	// allocate the slab itself
+	struct blockSlab *slab = malloc(sizeof(struct blockSlab));
+	if(slab == NULL){
+		error_d("block_pool_grow() could not allocate a new slab. slabCount =", (int)count);
+		return 2;
+	}
+	// nothing in this slab has been handed out yet.
+	memset(slab->live, 0, sizeof(slab->live));
+
+	// make room for one more slab pointer
+	long long newSize = arraySize;
+	struct blockSlab **newSlabs = NULL;
+	long long *newFreeList = NULL;
+	if(count >= arraySize){
+		newSize = arraySize ? arraySize*2 : 16;
+		newSlabs = malloc(newSize*sizeof(struct blockSlab *));
+		if(newSlabs == NULL){
+			free(slab);
+			error("block_pool_grow() could not grow the slab array. newSlabs = NULL");
+			return 1;
+		}
+		// the free list can never hold more indexes than there are slots, so grow it along with the slab array.
+		newFreeList = malloc(newSize*BLOCK_POOL_SLAB_SIZE*sizeof(long long));
+		if(newFreeList == NULL){
+			free(newSlabs);
+			free(slab);
+			error("block_pool_grow() could not grow the free list. newFreeList = NULL");
+			return 3;
+		}
+	}
+
+	SDL_AtomicLock(&poolLock);
+
+	// another thread may have grown the pool while this one was allocating. If there are free slots now, this slab isn't needed.
+	if(freeCount == 0){
+		// swap in the bigger arrays if they are still bigger than the ones in use.
+		if(slabCount >= slabArraySize && newSlabs != NULL && newSize > slabArraySize){
+			if(slabCount) memcpy(newSlabs, slabs, slabCount*sizeof(struct blockSlab *));
+			struct blockSlab **oldSlabs = slabs;
+			long long *oldFreeList = freeList;
+			slabs = newSlabs;
+			freeList = newFreeList;
+			slabArraySize = newSize;
+			// the old arrays get freed below, after the lock is released.
+			newSlabs = oldSlabs;
+			newFreeList = oldFreeList;
+		}
+
+		if(slabCount < slabArraySize){
+			slabs[slabCount] = slab;
+			// push the slots in reverse order so that they get handed out from the start of the slab.
+			int s;
+			for(s=BLOCK_POOL_SLAB_SIZE-1; s>=0; s--){
+				freeList[freeCount++] = slabCount*BLOCK_POOL_SLAB_SIZE + s;
+			}
+			slabCount++;
+			slab = NULL;
+		}
+	}
+
+	SDL_AtomicUnlock(&poolLock);
+
+	// free whatever was not swapped in (free(NULL) does nothing).
+	// if the slab wasn't used, the caller will find the slots another thread added, or it will call this again.
+	free(slab);
+	free(newSlabs);
+	free(newFreeList);
+
+	return 0;
+}
+
+
+
+/// this hands out a block from the block pool.
+// this can be called from any thread.
+// the returned block has all of its pointers set to NULL (parent, children, and neighbors) and it is flagged to be rendered.
+// the elevation data is NOT initialized. The caller is expected to fill it.
+// returns a pointer to the block on success
+// returns NULL if no memory could be allocated for the block
+struct blockData *block_pool_alloc(){
+
+	SDL_AtomicLock(&poolLock);
+	
+	// if there are no free slots, get another slab.
+	// the lock is let go while the slab is allocated. Another thread could take the new slots before this one gets the lock back, so keep checking.
+	while(freeCount == 0){
+		SDL_AtomicUnlock(&poolLock);
+		if(block_pool_grow()){
+			error("block_pool_alloc() could not grow the block pool.");
+			return NULL;
+		}
+		SDL_AtomicLock(&poolLock);
+	}
+
+	// take the next free slot
+	long long index = freeList[--freeCount];
+	struct blockSlab *slab = slabs[index/BLOCK_POOL_SLAB_SIZE];
+	struct blockData *block = &slab->blocks[index%BLOCK_POOL_SLAB_SIZE];
+	slab->live[index%BLOCK_POOL_SLAB_SIZE] = 1;
+	liveCount++;
+	allocatedCount++;
+
+	// clear everything except the elevation data (that is going to be filled in by the generator anyway).
+	// this is done before the lock is released so that anyone looking through the pool with block_pool_slot() never sees an old block's links.
+	memset(block, 0, offsetof(struct blockData, elevation));
+	block->poolIndex = index;
+	block_mark_all_dirty(block);
+
+	SDL_AtomicUnlock(&poolLock);
+
+	return block;
+}
+
+
+
+/// this gives a block back to the block pool so that its memory can be reused.
+// this can be called from any thread.
+// this does NOT touch any of the pointers in other blocks that point to this block. That is the job of whoever is freeing it.
+// returns 0 on success
+// returns 1 on NULL block
+// returns 2 if the block did not come from the block pool
+// returns 3 if the block was already freed
+short block_pool_free(struct blockData *block){
+
+	if(block == NULL){
+		error("block_pool_free() was sent NULL block. block = NULL");
+		return 1;
+	}
+
+	SDL_AtomicLock(&poolLock);
+
+	long long index = block->poolIndex;
+	if(index < 0 || index >= slabCount*BLOCK_POOL_SLAB_SIZE || &slabs[index/BLOCK_POOL_SLAB_SIZE]->blocks[index%BLOCK_POOL_SLAB_SIZE] != block){
+		SDL_AtomicUnlock(&poolLock);
+		error_d("block_pool_free() was sent a block that is not in the block pool. poolIndex =", (int)index);
+		return 2;
+	}
+
+	struct blockSlab *slab = slabs[index/BLOCK_POOL_SLAB_SIZE];
+	if(!slab->live[index%BLOCK_POOL_SLAB_SIZE]){
+		SDL_AtomicUnlock(&poolLock);
+		error_d("block_pool_free() was asked to free a block twice. poolIndex =", (int)index);
+		return 3;
+	}
+
+	// put the slot back on the free list
+	slab->live[index%BLOCK_POOL_SLAB_SIZE] = 0;
+	block->poolIndex = BLOCK_POOL_INDEX_INVALID;
+	freeList[freeCount++] = index;
+	liveCount--;
+
+	SDL_AtomicUnlock(&poolLock);
+
+	return 0;
+}
+
+
+
+/// this frees every block in the pool at once.
+/// before the program closes, this function will need to be called to clean up all of the blocks.
+// no other thread may be using the pool when this is called (stop the workers first).
+// any blockData pointers held anywhere in the program are invalid after this is called.
+// returns 0 on success.
+// returns 1 if there was nothing to clean up.
+short block_pool_clean_up(){
+
+	if(slabCount == 0){
+		error("block_pool_clean_up() asked to clean up. Nothing to clean up. This is not necessarily an error. It could be an error or just a warning.");
+		return 1;
+	}
+
+	gamelog_d("block_pool_clean_up() cleaning up blocks. liveCount =", (int)liveCount);
+
+	// freeing the slabs frees all of the blocks in them.
+	long long s;
+	for(s=0; s<slabCount; s++){
+		free(slabs[s]);
+	}
+	free(slabs);
+	free(freeList);
+
+	// set everything back to the default state
+	slabs = NULL;
+	freeList = NULL;
+	slabCount = 0;
+	slabArraySize = 0;
+	freeCount = 0;
+	liveCount = 0;
+
+	return 0;
+}
+
+
+
+/// returns the number of blocks currently handed out by the block pool.
+long long block_pool_count(){
+	SDL_AtomicLock(&poolLock);
+	long long count = liveCount;
+	SDL_AtomicUnlock(&poolLock);
+	return count;
+}
+
+
+
+/// returns the number of blocks that have been handed out by the block pool since the program started (including the ones that have been freed).
+// the difference between two calls is how many blocks were generated in between.
+long long block_pool_allocated_count(){
+	SDL_AtomicLock(&poolLock);
+	long long count = allocatedCount;
+	SDL_AtomicUnlock(&poolLock);
+	return count;
+}
+
+
+
+/// returns the number of slots in the block pool (both live and free).
+// use this with block_pool_slot() to visit every live block.
+long long block_pool_capacity(){
+	SDL_AtomicLock(&poolLock);
+	long long capacity = slabCount*BLOCK_POOL_SLAB_SIZE;
+	SDL_AtomicUnlock(&poolLock);
+	return capacity;
+}
+
+
+
+/// returns the block in slot "index" of the block pool.
+// returns NULL if the index is out of range or the slot is not currently handed out.
+// a block that is handed out may still be being built by another thread (it is not in the network until it is published, see block.h).
+struct blockData *block_pool_slot(long long index){
+
+	struct blockData *block = NULL;
+
+	// another thread could be growing the pool, so the slab array can only be looked at with the lock held.
+	SDL_AtomicLock(&poolLock);
+	if(index >= 0 && index < slabCount*BLOCK_POOL_SLAB_SIZE){
+		struct blockSlab *slab = slabs[index/BLOCK_POOL_SLAB_SIZE];
+		if(slab->live[index%BLOCK_POOL_SLAB_SIZE]) block = &slab->blocks[index%BLOCK_POOL_SLAB_SIZE];
+	}
+	SDL_AtomicUnlock(&poolLock);
+
+	return block;
+}
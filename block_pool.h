@@ -0,0 +1,23 @@
+//#include "block.h"
+
+/// block pool definitions
+// the block pool owns the memory of every blockData in the program.
+// blocks are handed out from big slabs of memory instead of being malloc()ed one at a time.
+// when a block is freed, its slot goes onto a free list and the next allocated block will reuse it.
+
+// this is how many blocks are allocated at once in each slab.
+// each block is about 236 kB (mostly elevation data), so a slab of 64 blocks is about 15 MB.
+#define BLOCK_POOL_SLAB_SIZE			64
+
+// this is the value of poolIndex for a block that did not come from the block pool.
+#define BLOCK_POOL_INDEX_INVALID		-1
+
+
+struct blockData *block_pool_alloc();
+short block_pool_free(struct blockData *block);
+short block_pool_clean_up();
+
+long long block_pool_count();
+long long block_pool_allocated_count();
+long long block_pool_capacity();
+struct blockData *block_pool_slot(long long index);
@@ -0,0 +1,134 @@
+#include <SDL2/SDL.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include "block.h"
+#include "block_stats.h"
+#include "block_pool.h"
+#include "block_index.h"
+#include "block_cache.h"
+#include "texture_cache.h"
+#include "prefetch.h"
+#include "utilities.h"
+
+
+// this is set by the signal handler when somebody asks for the stats (see block_stats_catch_signal()).
+static volatile sig_atomic_t statsRequested = 0;
+
+
+
+/// this fills stats with the numbers as they are right now.
+// this walks through every block in the block pool, so it isn't meant to be done every frame.
+// the block lock needs to be held (see block_lock()), and it needs to be called from the main thread (the texture cache belongs to it).
+// returns 0 on success
+// returns 1 on NULL stats
+short block_stats_collect(struct blockStats *stats){
+
+	if(stats == NULL){
+		error("block_stats_collect() was sent NULL stats. stats = NULL");
+		return 1;
+	}
+	memset(stats, 0, sizeof(struct blockStats));
+
+	// the levels are counted down from the top of the network (see block_top()), so it is all done in one pass through the block pool.
+	struct blockData *top = block_top();
+	if(top != NULL) stats->levelTop = top->level;
+	long long capacity = block_pool_capacity();
+	long long i;
+	struct blockData *block;
+	for(i=0; i<capacity; i++){
+		block = block_pool_slot(i);
+		if(block == NULL) continue;
+		stats->liveBlocks++;
+		// a parent that is still being built isn't part of the network yet (it is above the top), so it isn't counted on any level.
+		if(top == NULL || block->level > stats->levelTop) continue;
+		signed long long depth = stats->levelTop - block->level;
+		if(depth >= BLOCK_STATS_LEVELS) depth = BLOCK_STATS_LEVELS - 1;
+		stats->liveByLevel[depth]++;
+		if(depth+1 > stats->levelCount) stats->levelCount = depth+1;
+	}
+
+	stats->poolCapacity = capacity;
+	stats->poolBytes = capacity*(long long)sizeof(struct blockData);
+	stats->elevationBytes = stats->liveBlocks*(long long)sizeof(((struct blockData *)0)->elevation);
+	stats->indexedBlocks = block_index_count();
+
+	// every texture is BLOCK_WIDTH x BLOCK_HEIGHT ARGB8888 (see texture_cache.h).
+	stats->textures = texture_cache_count();
+	stats->textureBytes = stats->textures*(long long)BLOCK_WIDTH*BLOCK_HEIGHT*4;
+	stats->texturesEvicted = texture_cache_evicted_count();
+
+	stats->stepsAllocated = block_step_allocated_count();
+	stats->stepsLive = block_step_live_count();
+	stats->stepBytes = stats->stepsLive*(long long)sizeof(struct blockStep);
+
+	stats->blocksGenerated = block_pool_allocated_count();
+	stats->blocksPrefetched = prefetch_generated_count();
+	stats->blocksEvicted = block_cache_evicted_count();
+
+	return 0;
+}
+
+
+
+/// this writes the stats to the gamelog (the memory is in kB).
+void block_stats_print(const struct blockStats *stats){
+
+	if(stats == NULL){
+		error("block_stats_print() was sent NULL stats. stats = NULL");
+		return;
+	}
+
+	gamelog_d("block_stats_print() live blocks =", (int)stats->liveBlocks);
+	gamelog_d("block_stats_print() block pool capacity =", (int)stats->poolCapacity);
+	gamelog_d("block_stats_print() block pool kB =", (int)(stats->poolBytes/1024));
+	gamelog_d("block_stats_print() elevation kB =", (int)(stats->elevationBytes/1024));
+	gamelog_d("block_stats_print() indexed blocks =", (int)stats->indexedBlocks);
+	// each level gets its own message (the logger would think the same message over and over was spam, see logger.h).
+	char message[128];
+	int l;
+	for(l=0; l<stats->levelCount; l++){
+		if(l == BLOCK_STATS_LEVELS-1) snprintf(message, sizeof(message), "block_stats_print() live blocks on level %lld and below =", stats->levelTop - l);
+		else snprintf(message, sizeof(message), "block_stats_print() live blocks on level %lld =", stats->levelTop - l);
+		gamelog_d(message, (int)stats->liveByLevel[l]);
+	}
+	gamelog_d("block_stats_print() textures =", stats->textures);
+	gamelog_d("block_stats_print() texture kB =", (int)(stats->textureBytes/1024));
+	gamelog_d("block_stats_print() textures evicted =", (int)stats->texturesEvicted);
+	gamelog_d("block_stats_print() block steps allocated =", (int)stats->stepsAllocated);
+	gamelog_d("block_stats_print() block steps live =", (int)stats->stepsLive);
+	gamelog_d("block_stats_print() blocks generated =", (int)stats->blocksGenerated);
+	gamelog_d("block_stats_print() blocks prefetched =", (int)stats->blocksPrefetched);
+	gamelog_d("block_stats_print() blocks evicted =", (int)stats->blocksEvicted);
+	// a live blockStep between calls to block_generate_neighbor() means a list wasn't freed.
+	if(stats->stepsLive) error_d("block_stats_print() found blockSteps that were never freed. stepsLive =", (int)stats->stepsLive);
+}
+
+
+
+#ifdef SIGUSR1
+/// this is the signal handler. It only sets a flag (hardly anything is safe to do in a signal handler), and the main loop prints the stats.
+static void block_stats_signal(int sig){
+	statsRequested = 1;
+	// some systems put the default handler back after each signal.
+	signal(sig, block_stats_signal);
+}
+#endif
+
+
+
+/// this makes SIGUSR1 ask for the stats (see block_stats_requested()). It does nothing on systems that don't have SIGUSR1.
+void block_stats_catch_signal(){
+#ifdef SIGUSR1
+	signal(SIGUSR1, block_stats_signal);
+#endif
+}
+
+
+
+/// returns 1 if the stats have been asked for (by a signal) since the last time this was called.
+char block_stats_requested(){
+	if(!statsRequested) return 0;
+	statsRequested = 0;
+	return 1;
+}
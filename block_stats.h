@@ -0,0 +1,44 @@
+//#include "block.h"
+
+/// block stats definitions
+// the block stats are a snapshot of how much memory the block network is using, and how many blocks have been generated and evicted.
+// they are collected with block_stats_collect() and written to the gamelog with block_stats_print().
+// in the program, they are printed when the i key is pressed, or when the program gets SIGUSR1 (on systems that have it).
+
+// this is how many levels the live blocks are counted on (starting from the highest level). The blocks on any deeper levels are counted on the last one.
+#define BLOCK_STATS_LEVELS		32
+
+/// this is everything block_stats_collect() finds out.
+struct blockStats{
+	// this is how many blocks are live (handed out by the block pool), and how many the block pool has room for.
+	long long liveBlocks;
+	long long poolCapacity;
+	// this is how much memory the block pool has allocated (for every slot, live or free), and how much of that is elevation data of live blocks.
+	long long poolBytes;
+	long long elevationBytes;
+	// this is how many blocks are in the address index.
+	long long indexedBlocks;
+	// liveByLevel[i] is how many live blocks are on level (levelTop - i), where levelTop is the level of the top of the network (see block_top()).
+	// levelCount is how many entries are used. A block that is still being built above the top isn't counted on any level.
+	signed long long levelTop;
+	int levelCount;
+	long long liveByLevel[BLOCK_STATS_LEVELS];
+	// these are the textures in the texture cache.
+	int textures;
+	long long textureBytes;
+	long long texturesEvicted;
+	// these are the blockStep lists block_generate_neighbor() uses to walk the network.
+	long long stepsAllocated;
+	long long stepsLive;
+	long long stepBytes;
+	// this is how many blocks have been generated (by anyone), how many of those the prefetcher generated, and how many blocks have been evicted.
+	long long blocksGenerated;
+	long long blocksPrefetched;
+	long long blocksEvicted;
+};
+
+
+short block_stats_collect(struct blockStats *stats);
+void block_stats_print(const struct blockStats *stats);
+void block_stats_catch_signal();
+char block_stats_requested();
@@ -2,7 +2,11 @@
 #include "camera.h"
 #include "graphics.h"
 #include "utilities.h"
+#include "block_cache.h"
+#include "texture_cache.h"
+#include "trace.h"
 #include <stdlib.h>
+#include <math.h>
 
 
 
@@ -59,9 +63,9 @@ struct cameraData *camera_create(struct blockData *block){
 		return NULL;
 	}
 	
-	// set all camera settings to default.
-	cam->x = 0;
-	cam->y = 0;
+	// set all camera settings to default (looking at the center of the block).
+	cam->x = BLOCK_WIDTH/2;
+	cam->y = BLOCK_HEIGHT/2;
 	cam->scale = 1.0;
 	cam->target = block;
 	
@@ -71,18 +75,111 @@ struct cameraData *camera_create(struct blockData *block){
 
 
 
-/// this will make sure that your camera has valid parameters (1/3 < scale < 3, x within (BLOCK_WIDTH/2 - 1), and y within (BLOCK_HEIGHT/2 - 1)).
-// returns 0 on successful check
+/// this moves a block address and a coordinate on that block over to the block the coordinate is actually on (this works for x or y).
+// size is BLOCK_WIDTH for x or BLOCK_HEIGHT for y.
+// after this, 0 <= *coord < size.
+static void camera_coordinate_wrap(long long *address, float *coord, int size){
+	float blocks = floorf(*coord/size);
+	*address += (long long)blocks;
+	*coord -= blocks*size;
+	// floating point rounding can leave it sitting right on the far edge
+	if(*coord >= size) *coord = size - 1;
+	if(*coord < 0) *coord = 0;
+}
+
+
+
+/// this moves a block address and a coordinate on that block up to the parent's level (this works for x or y).
+static void camera_coordinate_up(long long *address, float *coord, int size){
+	long long parent = block_address_up(*address);
+	// this is which column (or row) of the parent the block is in.
+	int third = (int)(*address - (3*parent - 1));
+	*coord = third*(size/3) + *coord/BLOCK_LINEAR_SCALE_FACTOR;
+	*address = parent;
+}
+
+
+
+/// this moves a block address and a coordinate on that block down to the level of the child the coordinate is on (this works for x or y).
+static void camera_coordinate_down(long long *address, float *coord, int size){
+	int third = (int)(*coord/(size/3));
+	if(third < 0) third = 0;
+	if(third > 2) third = 2;
+	*address = 3*(*address) + third - 1;
+	*coord = (*coord - third*(size/3))*BLOCK_LINEAR_SCALE_FACTOR;
+}
+
+
+
+/// this will move the camera to look at (x, y) on the block at the address (level, addressX, addressY).
+// only the blocks on the way to that block are generated (see block_generate_address()).
+// the scale of the camera is not changed.
+// returns 0 on success
 // returns 1 on null cam pointer
-short camera_check(struct cameraData *cam){
+// returns 2 if the address is not valid (it is too deep, see BLOCK_ADDRESS_MAX)
+// returns 3 if the block could not be generated
+short camera_go_to(struct cameraData *cam, signed long long level, long long addressX, long long addressY, float x, float y){
 	
 	if(cam == NULL){
-		// report error
-		error("camera_check() was sent invalid cam. cam = NULL");
-		// and return an error
+		error("camera_go_to() was sent invalid cam. cam = NULL");
 		return 1;
 	}
 	
+	struct blockData *block;
+	if(block_locate(level, addressX, addressY, &block) == BLOCK_LOCATE_INVALID) return 2;
+	
+	block = block_generate_address(level, addressX, addressY);
+	if(block == NULL){
+		error_d("camera_go_to() could not generate the block at the address. level =", (int)level);
+		return 3;
+	}
+	
+	cam->target = block;
+	cam->x = x;
+	cam->y = y;
+	return 0;
+}
+
+
+
+/// this works out where the camera ends up from its target's address and goes straight there (see camera_check()).
+// returns 0 on success
+// returns 1 if the camera can't get there by address (the target has no address, or the camera is going too deep). Nothing about the camera is changed in that case.
+static short camera_check_address(struct cameraData *cam, signed long long level){
+	
+	if(!cam->target->addressValid) return 1;
+	
+	// this is where the camera is, as an address and a coordinate on the block at that address.
+	signed long long l = cam->target->level;
+	long long addressX = cam->target->addressX;
+	long long addressY = cam->target->addressY;
+	float x = cam->x;
+	float y = cam->y;
+	
+	// pan first, then follow the center of the camera up or down to the right level.
+	camera_coordinate_wrap(&addressX, &x, BLOCK_WIDTH);
+	camera_coordinate_wrap(&addressY, &y, BLOCK_HEIGHT);
+	for(; l < level; l++){
+		camera_coordinate_up(&addressX, &x, BLOCK_WIDTH);
+		camera_coordinate_up(&addressY, &y, BLOCK_HEIGHT);
+	}
+	for(; l > level; l--){
+		// the addresses of the children would be too big
+		if(llabs(addressX) > BLOCK_ADDRESS_MAX || llabs(addressY) > BLOCK_ADDRESS_MAX) return 1;
+		camera_coordinate_down(&addressX, &x, BLOCK_WIDTH);
+		camera_coordinate_down(&addressY, &y, BLOCK_HEIGHT);
+	}
+	
+	if(camera_go_to(cam, level, addressX, addressY, x, y)) return 1;
+	return 0;
+}
+
+
+
+/// this gets the camera back in bounds one step at a time by walking through the block network.
+// this is only used for blocks that don't have an address (see camera_check()).
+static void camera_check_steps(struct cameraData *cam){
+	
 	short check;
 	do{
 		
@@ -92,64 +189,87 @@ short camera_check(struct cameraData *cam){
 		check = 0;
 		
 		//--------------------------------------------------
-		// check to see if x is out of the bounds of the target block
+		// check to see if x or y are out of the bounds of the target block
 		//--------------------------------------------------
+		// the camera stays where it is if a neighbor can't be generated.
 		if(cam->x < 0){
-			// pan the camera appropriately
-			camera_pan(cam, CAMERA_PAN_LEFT);
-			// record that a single check was made.
-			check = 1;
+			if(camera_pan(cam, CAMERA_PAN_LEFT) == 0)	{cam->x += BLOCK_WIDTH; check = 1;}
+			else										cam->x = 0;
 		}
 		else if(cam->x >= BLOCK_WIDTH){
-			// pan the camera appropriately
-			camera_pan(cam, CAMERA_PAN_RIGHT);
-			// record that a single check was made.
-			check = 1;
+			if(camera_pan(cam, CAMERA_PAN_RIGHT) == 0)	{cam->x -= BLOCK_WIDTH; check = 1;}
+			else										cam->x = BLOCK_WIDTH - 1;
 		}
-		
-		//--------------------------------------------------
-		// check if y is out of bounds of the target block
-		//--------------------------------------------------
 		if(cam->y < 0){
-			// pan the camera appropriately
-			camera_pan(cam, CAMERA_PAN_UP);
-			// record that a single check was made.
-			check = 1;
+			if(camera_pan(cam, CAMERA_PAN_UP) == 0)		{cam->y += BLOCK_HEIGHT; check = 1;}
+			else										cam->y = 0;
 		}
 		else if(cam->y >= BLOCK_HEIGHT){
-			// pan the camera appropriately
-			camera_pan(cam, CAMERA_PAN_DOWN);
-			// record that a single check was made.
-			check = 1;
+			if(camera_pan(cam, CAMERA_PAN_DOWN) == 0)	{cam->y -= BLOCK_HEIGHT; check = 1;}
+			else										cam->y = BLOCK_HEIGHT - 1;
 		}
-		
+		if(check) continue;
 		
 		//--------------------------------------------------
-		// check for scale being too large
+		// check for scale being too large or too small (only once x and y are on the target)
 		//--------------------------------------------------
 		if(cam->scale >= BLOCK_LINEAR_SCALE_FACTOR){
-			// zoom out once
-			camera_zoom_out(cam);
-			// record that a single check was made
-			check = 1;
+			if(camera_zoom_out(cam) == 0) check = 1;
 		}
-		
-		//--------------------------------------------------
-		// check for scale being too small
-		//--------------------------------------------------
-		if(cam->scale <= 1/BLOCK_LINEAR_SCALE_FACTOR){
-			// zoom in once
-			camera_zoom_in(cam);
-			// record that a single check was made.
-			check = 1;
+		else if(cam->scale <= 1/BLOCK_LINEAR_SCALE_FACTOR){
+			if(camera_zoom_in(cam) == 0) check = 1;
 		}
 		
-		
-		
 	}while(check);	// loop again if a modification was made to the camera
+}
+
+
+
+/// this will make sure that your camera has valid parameters (1/3 < scale < 3, 0 <= x < BLOCK_WIDTH, and 0 <= y < BLOCK_HEIGHT).
+// the camera's new level and position are worked out first, and then the camera goes straight to the block at that address.
+// so a big jump in x or y (or many wheel notches at once) only looks up one block instead of panning and zooming one block at a time.
+// returns 0 on successful check
+// returns 1 on null cam pointer
+// returns 2 if the scale was not a positive number (it is set back to 1)
+short camera_check(struct cameraData *cam){
 	
+	TRACE_BLOCK("camera_check", cam != NULL ? cam->target : NULL);
 	
-	return 0;
+	if(cam == NULL){
+		// report error
+		error("camera_check() was sent invalid cam. cam = NULL");
+		// and return an error
+		return 1;
+	}
+	
+	short ret = 0;
+	if(!(cam->scale > 0) || isinf(cam->scale)){
+		error("camera_check() found a camera with an invalid scale. It is being set back to 1.");
+		cam->scale = 1;
+		ret = 2;
+	}
+	
+	// this is the level the camera will end up on, and the scale it will have there.
+	signed long long level = cam->target->level;
+	float scale = cam->scale;
+	while(scale >= BLOCK_LINEAR_SCALE_FACTOR){
+		scale /= BLOCK_LINEAR_SCALE_FACTOR;
+		level++;
+	}
+	while(scale <= 1/BLOCK_LINEAR_SCALE_FACTOR){
+		scale *= BLOCK_LINEAR_SCALE_FACTOR;
+		level--;
+	}
+	
+	if(level != cam->target->level || cam->x < 0 || cam->x >= BLOCK_WIDTH || cam->y < 0 || cam->y >= BLOCK_HEIGHT){
+		if(camera_check_address(cam, level) == 0)	cam->scale = scale;
+		else										camera_check_steps(cam);
+	}
+	
+	// the camera is looking at its target, so the block cache should keep it around.
+	block_cache_touch(cam->target);
+	
+	return ret;
 }
 
 
@@ -166,6 +286,7 @@ short camera_check(struct cameraData *cam){
 // returns 3 when xcenter is out of bounds and too far right.
 // returns 4 when ycenter is out of bounds and too far up.
 // returns 5 when ycenter is out of bounds and too far down.
+// returns 6 if the children could not be generated.
 short camera_zoom_in(struct cameraData *cam){
 	
 	// check for camera pointer being NULL
@@ -174,20 +295,9 @@ short camera_zoom_in(struct cameraData *cam){
 		return 1;
 	}
 	
-	/// TODO: write zoom in function.
-	// you will need to figure out which child you need to zoom to (this should be extremely easy)
-	// and you will need to figure out the (x,y) coordinate transformations between the current and the particular child.
-	
-	
-	
-	/// quick and dirty way to zoom in
-	
-	// verify that the children exist. If they don't already, this function will make them.
-	block_generate_children(cam->target);
-	// calculate which child to zoom in to.
-	// this calculates where the center of the camera is on the target block
-	int xcenter = cam->x + (BLOCK_WIDTH/2)*cam->scale + 0.5;
-	int ycenter = cam->y + (BLOCK_HEIGHT/2)*cam->scale + 0.5;
+	// this is where the center of the camera is on the target block
+	int xcenter = cam->x;
+	int ycenter = cam->y;
 	
 	// test error conditions
 	if(xcenter < 0){
@@ -207,8 +317,19 @@ short camera_zoom_in(struct cameraData *cam){
 		return 5;
 	}
 	
+	// verify that the children exist. If they don't already, this function will make them.
+	if(block_generate_children(cam->target)){
+		error("camera_zoom_in() could not generate the children of the target.");
+		return 6;
+	}
+	
 	// update target to proper child
-	cam->target = cam->target->children[xcenter/BLOCK_WIDTH_1_3 + 3*(ycenter/BLOCK_WIDTH_1_3)];
+	int cx = xcenter/BLOCK_WIDTH_1_3;
+	int cy = ycenter/BLOCK_HEIGHT_1_3;
+	cam->target = cam->target->children[cx + 3*cy];
+	// the same point on the child is three times farther from the child's corner.
+	cam->x = (cam->x - cx*BLOCK_WIDTH_1_3)*BLOCK_LINEAR_SCALE_FACTOR;
+	cam->y = (cam->y - cy*BLOCK_HEIGHT_1_3)*BLOCK_LINEAR_SCALE_FACTOR;
 	// update the scale of the camera now that it is pointing at the child of the previous block
 	cam->scale *= BLOCK_LINEAR_SCALE_FACTOR;
 	
@@ -223,6 +344,7 @@ short camera_zoom_in(struct cameraData *cam){
 /// It is discouraged to call this function from any place other than camera_check()
 // returns 0 on success
 // returns 1 on invalid cameraData pointer
+// returns 2 if the parent could not be generated
 short camera_zoom_out(struct cameraData *cam){
 	
 	// check for camera pointer being NULL
@@ -231,17 +353,16 @@ short camera_zoom_out(struct cameraData *cam){
 		return 1;
 	}
 	
+	// this will verify that a parent has been added (the prefetcher has usually generated it already).
+	if(cam->target->parent == NULL && block_generate_parent(cam->target)){
+		error("camera_zoom_out() could not generate the parent of the target.");
+		return 2;
+	}
 	
-	
-	/// TODO: write function to calculate the (x,y) coordinate transformations between the current block and the parent.
-	// this will probably require some math on pen and paper.
-	
-	
-	
-	/// this is a temporary (visually choppy) solution for testing:
-	
-	// this will verify that a parent has been added.
-	block_generate_parent(cam->target);
+	// the same point on the parent is a third as far from the target's corner, and the target is offset by which child of the parent it is.
+	short view = cam->target->parentView;
+	cam->x = (view%3)*BLOCK_WIDTH_1_3 + cam->x/BLOCK_LINEAR_SCALE_FACTOR;
+	cam->y = (view/3)*BLOCK_HEIGHT_1_3 + cam->y/BLOCK_LINEAR_SCALE_FACTOR;
 	
 	// move to the parent
 	cam->target = cam->target->parent;
@@ -264,6 +385,7 @@ short camera_zoom_out(struct cameraData *cam){
 // returns 0 on success
 // returns 1 on invalid cameraData pointer
 // returns 2 on invalid pan direction
+// returns 3 if the neighbor could not be generated
 short camera_pan(struct cameraData *cam, short panDir){
 	
 	// check for camera pointer being NULL
@@ -273,31 +395,13 @@ short camera_pan(struct cameraData *cam, short panDir){
 	}
 	
 	
+	// this is the neighbor of the target the camera is moving to.
+	short neighbor;
 	switch(panDir){
-		case CAMERA_PAN_UP:
-			// verify that the neighbor exists. If it doesn't exist, this function will create it.
-			block_generate_neighbor(cam->target, BLOCK_NEIGHBOR_UP);
-			// move the neighbor
-			cam->target = (cam->target)->neighbors[BLOCK_NEIGHBOR_UP];
-			break;
-		case CAMERA_PAN_DOWN:
-			// verify that the neighbor exists. If it doesn't exist, this function will create it.
-			block_generate_neighbor(cam->target, BLOCK_NEIGHBOR_DOWN);
-			// move the neighbor
-			cam->target = (cam->target)->neighbors[BLOCK_NEIGHBOR_DOWN];
-			break;
-		case CAMERA_PAN_LEFT:
-			// verify that the neighbor exists. If it doesn't exist, this function will create it.
-			block_generate_neighbor(cam->target, BLOCK_NEIGHBOR_LEFT);
-			// move the neighbor
-			cam->target = (cam->target)->neighbors[BLOCK_NEIGHBOR_LEFT];
-			break;
-		case CAMERA_PAN_RIGHT:
-			// verify that the neighbor exists. If it doesn't exist, this function will create it.
-			block_generate_neighbor(cam->target, BLOCK_NEIGHBOR_RIGHT);
-			// move the neighbor
-			cam->target = (cam->target)->neighbors[BLOCK_NEIGHBOR_RIGHT];
-			break;
+		case CAMERA_PAN_UP:		neighbor = BLOCK_NEIGHBOR_UP;		break;
+		case CAMERA_PAN_DOWN:	neighbor = BLOCK_NEIGHBOR_DOWN;		break;
+		case CAMERA_PAN_LEFT:	neighbor = BLOCK_NEIGHBOR_LEFT;		break;
+		case CAMERA_PAN_RIGHT:	neighbor = BLOCK_NEIGHBOR_RIGHT;	break;
 		default:
 			// report error
 			error_d("camera_pan() sent invalid panDir. panDir =", panDir);
@@ -305,6 +409,15 @@ short camera_pan(struct cameraData *cam, short panDir){
 			break;
 	}
 	
+	// neighbors are linked as soon as they are generated, so this is usually just following the pointer. If it doesn't exist yet, it gets generated.
+	if((cam->target)->neighbors[neighbor] == NULL) block_generate_neighbor(cam->target, neighbor);
+	if((cam->target)->neighbors[neighbor] == NULL){
+		error_d("camera_pan() could not generate the neighbor of the target. panDir =", panDir);
+		return 3;
+	}
+	// move to the neighbor
+	cam->target = (cam->target)->neighbors[neighbor];
+	
 	// success
 	return 0;
 }
@@ -313,11 +426,203 @@ short camera_pan(struct cameraData *cam, short panDir){
 
 
 
+/// this is where the blocks of a camera's view go on the screen (see camera_view()).
+struct cameraView{
+	// this is the block that the tiles are counted from. Tile (0, 0) is this block.
+	struct blockData *block;
+	// this is where the upper left corner of block is on the screen, and how big each block is on the screen (in pixels).
+	float originX, originY;
+	float blockW, blockH;
+	// this is the range of tiles (relative to block) that are on the screen. Everything else is culled.
+	int iMin, iMax, jMin, jMax;
+};
+
+
+
+/// this works out which blocks cover the screen for cam, and where they go.
+// nothing is generated. If the camera is zoomed out past 1:1 and the target's parent exists, the blocks are drawn from the parent's level.
+// returns 0 on success
+// returns 4 if the size of the renderer's output could not be found.
+static short camera_view(SDL_Renderer *dest, struct cameraData *cam, struct cameraView *view){
+	
+	// find out how big the screen is
+	int screenW, screenH;
+	if(SDL_GetRendererOutputSize(dest, &screenW, &screenH) || screenW <= 0 || screenH <= 0){
+		error("camera_view() could not get the size of the renderer's output.");
+		return 4;
+	}
+	
+	// the blocks are drawn from the target's level. When the camera is zoomed out past 1:1, they are drawn from the parent's level instead.
+	// that way the blocks are always at least as big as the screen, so there are never more than 2x2 of them to draw.
+	// if the parent hasn't been generated yet (the prefetcher keeps it generated), the target's level is used. The blocks are at least a third of the screen then, so there are never more than 4x4 of them.
+	struct blockData *block = cam->target;
+	float x = cam->x;
+	float y = cam->y;
+	float scale = cam->scale;
+	if(scale > 1 && block->parent != NULL){
+		x = (block->parentView%3)*BLOCK_WIDTH_1_3 + x/BLOCK_LINEAR_SCALE_FACTOR;
+		y = (block->parentView/3)*BLOCK_HEIGHT_1_3 + y/BLOCK_LINEAR_SCALE_FACTOR;
+		scale /= BLOCK_LINEAR_SCALE_FACTOR;
+		block = block->parent;
+	}
+	
+	// this is how many pixels wide each element of the block is.
+	// at a scale of 1, one block fills the screen (the longer side of it).
+	float pixels = (screenW > screenH ? screenW : screenH)/(BLOCK_WIDTH*scale);
+	view->block = block;
+	// the camera is at the center of the screen.
+	view->originX = screenW/2.0f - x*pixels;
+	view->originY = screenH/2.0f - y*pixels;
+	view->blockW = BLOCK_WIDTH*pixels;
+	view->blockH = BLOCK_HEIGHT*pixels;
+	view->iMin = (int)floorf(-view->originX/view->blockW);
+	view->iMax = (int)floorf((screenW - 1 - view->originX)/view->blockW);
+	view->jMin = (int)floorf(-view->originY/view->blockH);
+	view->jMax = (int)floorf((screenH - 1 - view->originY)/view->blockH);
+	
+	return 0;
+}
+
+
+
+/// this follows the neighbor links from block to the block that is (i, j) blocks away (on the same level).
+// if acrossFirst is 1, it goes left or right first and then up or down. Otherwise it goes up or down first.
+// nothing is generated. returns NULL if one of the blocks on the way hasn't been generated (or linked) yet.
+static struct blockData *camera_walk(struct blockData *block, int i, int j, char acrossFirst){
+	
+	int pass;
+	for(pass=0; pass<2 && block!=NULL; pass++){
+		if((pass == 0) == (acrossFirst != 0)){
+			for(; i<0 && block!=NULL; i++) block = block->neighbors[BLOCK_NEIGHBOR_LEFT];
+			for(; i>0 && block!=NULL; i--) block = block->neighbors[BLOCK_NEIGHBOR_RIGHT];
+		}
+		else{
+			for(; j<0 && block!=NULL; j++) block = block->neighbors[BLOCK_NEIGHBOR_UP];
+			for(; j>0 && block!=NULL; j--) block = block->neighbors[BLOCK_NEIGHBOR_DOWN];
+		}
+	}
+	return block;
+}
+
+
+
+/// this finds the block that is (i, j) blocks away from block (on the same level) without generating anything.
+// returns NULL if that block hasn't been generated yet.
+static struct blockData *camera_find(struct blockData *block, int i, int j){
+	struct blockData *found = camera_walk(block, i, j, 1);
+	// a diagonal block can be reached either way, so if one of the blocks on the first way is missing, the other way is tried.
+	if(found == NULL && i != 0 && j != 0) found = camera_walk(block, i, j, 0);
+	return found;
+}
+
+
+
+/// this finds a block higher up in the network whose image covers the tile that is (i, j) blocks away from block, for when that tile's block hasn't been generated yet.
+// it looks up to CAMERA_RENDER_FALLBACK_LEVELS levels up. src is set to the part of the stand-in's image that covers the tile.
+// returns NULL if no block that covers the tile has been generated.
+static struct blockData *camera_stand_in(struct blockData *block, int i, int j, SDL_Rect *src){
+	
+	// (x, y) is where the tile is from the upper left corner of block, in tiles. size is how many tiles wide block is.
+	long long x = i, y = j, size = 1;
+	int level;
+	for(level=1; level<=CAMERA_RENDER_FALLBACK_LEVELS && block->parent != NULL; level++){
+		x += (block->parentView%3)*size;
+		y += (block->parentView/3)*size;
+		size *= 3;
+		block = block->parent;
+		// the tile is either inside this block or inside one of the blocks around it.
+		int ax = (x >= 0) ? (int)(x/size) : -(int)((size - 1 - x)/size);
+		int ay = (y >= 0) ? (int)(y/size) : -(int)((size - 1 - y)/size);
+		struct blockData *standIn = camera_find(block, ax, ay);
+		if(standIn != NULL){
+			src->w = BLOCK_WIDTH/size;
+			src->h = BLOCK_HEIGHT/size;
+			src->x = (x - ax*size)*src->w;
+			src->y = (y - ay*size)*src->h;
+			return standIn;
+		}
+	}
+	return NULL;
+}
+
+
+
+/// this generates the block that is (i, j) blocks away from block (on the same level), next to a block that has already been generated.
+// this is only for the blocks that the prefetcher can't generate (see prefetch.h), and for getting a view ready with camera_generate_view().
+// returns the block, or NULL if there was no generated block next to it or it could not be generated.
+static struct blockData *camera_generate_tile(struct blockData *block, int i, int j){
+	
+	// step back from the tile towards block, across first and then up or down, until a block that exists is found.
+	int si = (i > 0) - (i < 0);
+	int sj = (j > 0) - (j < 0);
+	struct blockData *from;
+	short neighbor;
+	if(i != 0 && (from = camera_find(block, i - si, j)) != NULL) neighbor = si > 0 ? BLOCK_NEIGHBOR_RIGHT : BLOCK_NEIGHBOR_LEFT;
+	else if(j != 0 && (from = camera_find(block, i, j - sj)) != NULL) neighbor = sj > 0 ? BLOCK_NEIGHBOR_DOWN : BLOCK_NEIGHBOR_UP;
+	else return NULL;
+	
+	if(from->neighbors[neighbor] == NULL) block_generate_neighbor(from, neighbor);
+	return from->neighbors[neighbor];
+}
+
+
+
+/// this generates every block that camera_render() would draw for cam (and the target's parent, if the camera is zoomed out past 1:1).
+// camera_render() doesn't generate anything, so use this when the whole view has to be there when it is drawn (like when writing images in headless mode).
+// returns 0 on success.
+// returns 1 if dest or cam is NULL.
+// returns 3 if cam->target is NULL.
+// returns 4 if the size of the renderer's output could not be found.
+// returns 5 if one of the blocks could not be generated.
+short camera_generate_view(SDL_Renderer *dest, struct cameraData *cam){
+	
+	if(dest == NULL || cam == NULL){
+		error("camera_generate_view() was sent a NULL renderer or camera.");
+		return 1;
+	}
+	if(cam->target == NULL){
+		error("camera_generate_view() was sent a valid camera with an invalid target blockData pointer. cam->target = NULL");
+		return 3;
+	}
+	
+	// the target might not be one of the blocks that gets drawn (see camera_render()), but the block cache still has to keep it.
+	block_cache_touch(cam->target);
+	if(cam->scale > 1 && cam->target->parent == NULL) block_generate_parent(cam->target);
+	
+	struct cameraView view;
+	if(camera_view(dest, cam, &view)) return 4;
+	
+	// the tiles are generated from the block outwards (in order of how many steps away they are), so the block one step closer to it is always there already.
+	int i, j, steps;
+	int maxSteps = (-view.iMin > view.iMax ? -view.iMin : view.iMax) + (-view.jMin > view.jMax ? -view.jMin : view.jMax);
+	for(steps=1; steps<=maxSteps; steps++){
+		for(j=view.jMin; j<=view.jMax; j++){
+			for(i=view.iMin; i<=view.iMax; i++){
+				if(abs(i) + abs(j) != steps) continue;
+				if(camera_find(view.block, i, j) == NULL && camera_generate_tile(view.block, i, j) == NULL){
+					error_d("camera_generate_view() could not generate one of the blocks on the screen. i =", i);
+					error_d("camera_generate_view() could not generate one of the blocks on the screen. j =", j);
+					return 5;
+				}
+			}
+		}
+	}
+	
+	return 0;
+}
+
+
+
 /// this will render the "cam" cameraData to the "dest" renderer.
+// the camera's center (x, y) is drawn at the center of the screen, and all of the blocks that cover the screen are drawn around it.
+// this does NOT generate blocks (the prefetcher does that, see prefetch.h), so drawing never has to wait for them.
+// a block that hasn't been generated yet is drawn with the part of a block higher up in the network that covers it (up to CAMERA_RENDER_FALLBACK_LEVELS levels up).
+// the only exception is blocks that are too deep to have an address, because the prefetcher can't generate those. At most CAMERA_RENDER_MAX_GENERATED of them are generated per call.
 // returns 0 on successful rendering.
 // returns 1 if the dest pointer is NULL.
 // returns 2 if the cam pointer is NULL.
 // returns 3 if cam->target is NULL.
+// returns 4 if the size of the renderer's output could not be found.
 short camera_render(SDL_Renderer *dest, struct cameraData *cam){
 	
 	// check to see if dest is invalid
@@ -361,13 +666,47 @@ short camera_render(SDL_Renderer *dest, struct cameraData *cam){
 	*/
 	
 	
-	// if the target block has not been rendered, render it now.
-	if(cam->target->texture == NULL || cam->target->renderMe)
-		block_render(cam->target, dest);
-	
-	SDL_RenderCopy(dest, cam->target->texture, NULL, NULL);
-	
-	
+	// when the camera is zoomed out past 1:1, the blocks are drawn from the parent's level and the target isn't one of them.
+	// the camera still points at the target, so it is touched here. Otherwise the block cache could evict it out from under the camera.
+	block_cache_touch(cam->target);
+	
+	struct cameraView view;
+	if(camera_view(dest, cam, &view)) return 4;
+	
+	int i, j;
+	int generated = 0;
+	SDL_Rect rect, src;
+	for(j=view.jMin; j<=view.jMax; j++){
+		for(i=view.iMin; i<=view.iMax; i++){
+			// the edges are rounded the same way for both blocks that share them, so there are never any gaps or overlaps between blocks.
+			rect.x = (int)floorf(view.originX + i*view.blockW + 0.5f);
+			rect.y = (int)floorf(view.originY + j*view.blockH + 0.5f);
+			rect.w = (int)floorf(view.originX + (i+1)*view.blockW + 0.5f) - rect.x;
+			rect.h = (int)floorf(view.originY + (j+1)*view.blockH + 0.5f) - rect.y;
+			
+			struct blockData *current = camera_find(view.block, i, j);
+			// the prefetcher can't generate blocks that don't have an address, so a few of them are generated here.
+			if(current == NULL && !view.block->addressValid && generated < CAMERA_RENDER_MAX_GENERATED){
+				current = camera_generate_tile(view.block, i, j);
+				generated++;
+			}
+			
+			SDL_Rect *srcRect = NULL;
+			if(current == NULL){
+				// draw the part of a bigger block that covers this one until it is generated.
+				current = camera_stand_in(view.block, i, j, &src);
+				if(current == NULL) continue;
+				srcRect = &src;
+			}
+			
+			// the blocks are being looked at, so the block cache should keep them around.
+			block_cache_touch(current);
+			
+			// the texture cache renders the block if it hasn't been rendered (or if it has changed).
+			SDL_Texture *texture = texture_cache_get(dest, current);
+			if(texture != NULL) SDL_RenderCopy(dest, texture, srcRect, &rect);
+		}
+	}
 	
 	// successful print.
 	return 0;
@@ -8,6 +8,11 @@
 #define CAMERA_PAN_LEFT		3
 #define CAMERA_PAN_RIGHT	5
 
+// when a block on the screen hasn't been generated yet, camera_render() looks this many levels up for a block that covers it and draws part of that block instead.
+#define CAMERA_RENDER_FALLBACK_LEVELS	4
+// this is the most blocks camera_render() will generate in one call. It only generates blocks that are too deep to have an address (the prefetcher can't generate those).
+#define CAMERA_RENDER_MAX_GENERATED		1
+
 /// this describes where the user is looking in the fractal block network.
 // This holds data that describes what the user wants to see.
 // Camera functions will be used to translate what the user wants to see into which blocks the program has to render.
@@ -28,7 +33,8 @@ struct cameraData {
 	// if either x or y are greater than (BLOCK_WIDTH-1), the camera will have to pan right or down respectively.
 	// if either x or y are less than 0, the camera will have to pan left or up respectively.
 	// the camera is centered on [x][y] of the target block.
-	int x, y;
+	// these are floats so that the camera doesn't drift when it zooms in and out (zooming out divides them by 3).
+	float x, y;
 };
 
 
@@ -43,13 +49,17 @@ struct cameraData {
 // this function will probably not need to be used as it is just modifying a few variables.
 short camera_user_input(struct cameraData *cam, int xdiff, int ydiff, float scaleMult);
 
-// this will initialize a camera too look at the origin with x=0, y=0, scale = 1.
+// this will initialize a camera too look at the center of the block with scale = 1.
 struct cameraData *camera_create(struct blockData *block);
 
 // this makes sure that the cameraData is within bounds of a block/level.
-// It will will user camera_pan, camera_zoom_in, and camera_zoom_out to navigate to the fractal block network and update the cameraData.
+// it works out the address of the block the camera ends up on in one step and goes straight there (see camera_go_to()).
+// blocks that are too deep to have an address fall back on camera_pan, camera_zoom_in, and camera_zoom_out.
 short camera_check(struct cameraData *cam);
 
+// this moves the camera to the block at an address (see "Block Addresses" in block.h), generating only the blocks on the way to it.
+short camera_go_to(struct cameraData *cam, signed long long level, long long addressX, long long addressY, float x, float y);
+
 
 // these are for manipulation of the camera (done by the program)
 
@@ -61,6 +71,9 @@ short camera_zoom_in(struct cameraData *cam);
 short camera_zoom_out(struct cameraData *cam);
 
 // this will render the camera to an SDL_Renderer
+// it draws the blocks that have already been generated, and stands in for the ones that haven't (see camera.c).
 short camera_render(SDL_Renderer *dest, struct cameraData *cam);
+// this generates all of the blocks camera_render() would draw, for when the view has to be complete (like in headless mode).
+short camera_generate_view(SDL_Renderer *dest, struct cameraData *cam);
 
 
@@ -0,0 +1,301 @@
+#include "block.h"
+#include "colormap.h"
+#include <SDL2/SDL.h>
+#include "camera.h"
+#include "graphics.h"
+#include "utilities.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+// this is the colormap that blocks are rendered with. By default, the elevation is used directly as a color.
+static struct colormap currentMap = {COLORMAP_RAW, 0.0f, 16777215.0f, NULL, 0};
+
+
+/// this is a point on a palette's gradient.
+struct colormapStop{
+	// this is how far up the range of elevation the color is (0 is the lowest, 1 is the highest).
+	float position;
+	Uint32 color;
+};
+
+// these are the gradients of the palettes that use lookup tables (they have to start at 0 and end at 1).
+static const struct colormapStop terrainStops[] = {
+	{0.00f, 0xff000830},	// deep water
+	{0.40f, 0xff0a4a8c},	// shallow water
+	{0.45f, 0xffd8cc94},	// beach
+	{0.52f, 0xff3c8c32},	// grass
+	{0.70f, 0xff6a7a2c},	// hills
+	{0.85f, 0xff7a6450},	// rock
+	{0.95f, 0xffb4b4b4},	// high rock
+	{1.00f, 0xffffffff}		// snow
+};
+static const struct colormapStop heatStops[] = {
+	{0.00f, 0xff000000},
+	{0.40f, 0xffc81400},
+	{0.75f, 0xffffdc00},
+	{1.00f, 0xffffffff}
+};
+
+// these are the lookup tables of the palettes. They are built once by colormap_init().
+static Uint32 terrainLut[COLORMAP_LUT_SIZE];
+static Uint32 heatLut[COLORMAP_LUT_SIZE];
+static int lutsBuilt = 0;
+
+// this is the palette that is being used (one of the COLORMAP_PALETTE_ values).
+static int currentPalette = COLORMAP_PALETTE_RAW;
+
+
+
+/// this turns one elevation value into a color.
+// scale and top are worked out by colormap_convert_region().
+// this does exactly the same math as colormap_convert4(), so it is used for the pixels that don't fit in a 4x4 tile.
+static inline Uint32 colormap_pixel(float e, const struct colormap *map, short mode, float scale, float top){
+	if(mode == COLORMAP_RAW) return ((Uint32)(int)e) | 0xff000000;
+
+	float v = (e - map->min)*scale;
+	// this is written so that NaN turns into 0 (the same as _mm_max_ps() does)
+	if(!(v > 0)) v = 0;
+	if(v > top) v = top;
+	int index = (int)v;
+
+	if(mode == COLORMAP_GRAY) return 0xff000000 | (index<<16) | (index<<8) | index;
+	return map->lut[index];
+}
+
+
+
+#ifdef __SSE2__
+/// this turns four elevation values (one row of a tile) into colors and stores them in dest.
+static inline void colormap_convert4(Uint32 *dest, __m128 e, const struct colormap *map, short mode, __m128 vMin, __m128 vScale, __m128 vTop){
+
+	const __m128i alpha = _mm_set1_epi32(0xff000000);
+	if(mode == COLORMAP_RAW){
+		_mm_storeu_si128((__m128i *)dest, _mm_or_si128(_mm_cvttps_epi32(e), alpha));
+		return;
+	}
+
+	__m128 v = _mm_mul_ps(_mm_sub_ps(e, vMin), vScale);
+	v = _mm_max_ps(v, _mm_setzero_ps());
+	v = _mm_min_ps(v, vTop);
+	__m128i index = _mm_cvttps_epi32(v);
+
+	if(mode == COLORMAP_GRAY){
+		__m128i gray = _mm_or_si128(_mm_or_si128(index, _mm_slli_epi32(index, 8)), _mm_slli_epi32(index, 16));
+		_mm_storeu_si128((__m128i *)dest, _mm_or_si128(gray, alpha));
+		return;
+	}
+
+	// SSE2 can't look things up in a table, so the indexes are looked up one at a time.
+	int indexes[4];
+	_mm_storeu_si128((__m128i *)indexes, index);
+	dest[0] = map->lut[indexes[0]];
+	dest[1] = map->lut[indexes[1]];
+	dest[2] = map->lut[indexes[2]];
+	dest[3] = map->lut[indexes[3]];
+}
+#endif
+
+
+
+/// this converts the elements [x0,x1) x [y0,y1) of a block's elevation data into ARGB pixels.
+// pixels is the first row of the image (the pixel of element x0,y0) and pitch is the number of bytes from one row to the next (like a locked SDL_Texture).
+// elevation is stored one column at a time, but the image is written one row at a time so that the writes are in order.
+// with SSE2, 4x4 tiles of elevation are loaded (four columns) and transposed (into four rows) so that four pixels can be converted at once.
+// map can be NULL to use the current colormap.
+void colormap_convert_region(float elevation[BLOCK_WIDTH][BLOCK_HEIGHT], int x0, int y0, int x1, int y1, void *pixels, int pitch, const struct colormap *map){
+
+	if(map == NULL) map = &currentMap;
+
+	// a palette without any colors in it is drawn in gray instead.
+	short mode = map->mode;
+	if(mode == COLORMAP_PALETTE && (map->lut == NULL || map->lutSize <= 0)) mode = COLORMAP_GRAY;
+
+	// the elevation range [min, max] is scaled to [0, top].
+	float top = (mode == COLORMAP_PALETTE) ? map->lutSize - 1 : 255;
+	float scale = (map->max > map->min) ? top/(map->max - map->min) : 0;
+
+	// the rows and columns of the image are the rows and columns of the region (pixel i-x0 of row j-y0 is element i,j).
+	int i, j = y0, k;
+
+#ifdef __SSE2__
+	__m128 vMin = _mm_set1_ps(map->min);
+	__m128 vScale = _mm_set1_ps(scale);
+	__m128 vTop = _mm_set1_ps(top);
+
+	for(; j+4<=y1; j+=4){
+		Uint32 *row[4];
+		for(k=0; k<4; k++){
+			row[k] = (Uint32 *)((Uint8 *)pixels + (j+k-y0)*pitch);
+		}
+
+		for(i=x0; i+4<=x1; i+=4){
+			// these start out as four columns (x = i to i+3) of four elevations (y = j to j+3)
+			__m128 r0 = _mm_loadu_ps(&elevation[i  ][j]);
+			__m128 r1 = _mm_loadu_ps(&elevation[i+1][j]);
+			__m128 r2 = _mm_loadu_ps(&elevation[i+2][j]);
+			__m128 r3 = _mm_loadu_ps(&elevation[i+3][j]);
+			// and now they are four rows
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+			colormap_convert4(row[0]+i-x0, r0, map, mode, vMin, vScale, vTop);
+			colormap_convert4(row[1]+i-x0, r1, map, mode, vMin, vScale, vTop);
+			colormap_convert4(row[2]+i-x0, r2, map, mode, vMin, vScale, vTop);
+			colormap_convert4(row[3]+i-x0, r3, map, mode, vMin, vScale, vTop);
+		}
+
+		// the columns that didn't fit in a tile
+		for(; i<x1; i++){
+			for(k=0; k<4; k++){
+				row[k][i-x0] = colormap_pixel(elevation[i][j+k], map, mode, scale, top);
+			}
+		}
+	}
+#endif
+
+	// the rows that didn't fit in a tile (or all of them without SSE2)
+	for(; j<y1; j++){
+		Uint32 *row = (Uint32 *)((Uint8 *)pixels + (j-y0)*pitch);
+		for(i=x0; i<x1; i++){
+			row[i-x0] = colormap_pixel(elevation[i][j], map, mode, scale, top);
+		}
+	}
+}
+
+
+
+/// this converts all of the elevation data of a block into BLOCK_WIDTH x BLOCK_HEIGHT ARGB pixels (see colormap_convert_region()).
+void colormap_convert_block(float elevation[BLOCK_WIDTH][BLOCK_HEIGHT], void *pixels, int pitch, const struct colormap *map){
+	colormap_convert_region(elevation, 0, 0, BLOCK_WIDTH, BLOCK_HEIGHT, pixels, pitch, map);
+}
+
+
+
+/// returns the colormap that blocks are rendered with.
+const struct colormap *colormap_current(){
+	return &currentMap;
+}
+
+
+
+/// this sets the colormap that blocks are rendered with.
+// the colormap is copied, but the lut is not (it needs to stay around).
+// the blocks are not re-rendered by this (see texture_cache_invalidate()).
+void colormap_set_current(const struct colormap *map){
+	if(map != NULL) currentMap = *map;
+}
+
+
+
+/// this fills lut with the gradient that goes through the stops.
+// the colors in between the stops are mixed with color_mix_weighted(). This is only done once, so drawing a pixel is just one table lookup.
+static void colormap_build_lut(Uint32 *lut, const struct colormapStop *stops, int stopCount){
+	int i, s = 0;
+	for(i=0; i<COLORMAP_LUT_SIZE; i++){
+		float position = i/(float)(COLORMAP_LUT_SIZE-1);
+		// find the two stops that this position is between
+		while(s < stopCount-2 && position > stops[s+1].position) s++;
+		float width = stops[s+1].position - stops[s].position;
+		float t = (width > 0) ? (position - stops[s].position)/width : 1;
+		if(t < 0) t = 0;
+		if(t > 1) t = 1;
+		// the weights are whole numbers, so the fraction is spread over 1000.
+		unsigned int weight = (unsigned int)(t*1000 + 0.5f);
+		lut[i] = color_mix_weighted(stops[s].color, stops[s+1].color, 1000 - weight, weight);
+	}
+}
+
+
+
+/// this builds the lookup tables of all the palettes and picks the terrain palette.
+// call this once before any blocks are rendered.
+void colormap_init(){
+	if(!lutsBuilt){
+		colormap_build_lut(terrainLut, terrainStops, sizeof(terrainStops)/sizeof(terrainStops[0]));
+		colormap_build_lut(heatLut, heatStops, sizeof(heatStops)/sizeof(heatStops[0]));
+		lutsBuilt = 1;
+	}
+	colormap_select_palette(COLORMAP_PALETTE_TERRAIN);
+}
+
+
+
+/// this sets the range of elevation that the palettes are spread over.
+// the lowest color of the palette is used for min (and below) and the highest color is used for max (and above).
+void colormap_set_range(float min, float max){
+	if(min > max){
+		float temp = min;
+		min = max;
+		max = temp;
+	}
+	currentMap.min = min;
+	currentMap.max = max;
+}
+
+
+
+/// this sets the range of elevation that the palettes are spread over to the lowest and highest elevation in block.
+// this is meant to be used on a block near the top of the world, so that the range fits the whole world.
+void colormap_fit_range(struct blockData *block){
+	if(block == NULL){
+		error("colormap_fit_range() was sent NULL block. block = NULL");
+		return;
+	}
+	float min = block->elevation[0][0];
+	float max = block->elevation[0][0];
+	int i, j;
+	for(i=0; i<BLOCK_WIDTH; i++){
+		for(j=0; j<BLOCK_HEIGHT; j++){
+			if(block->elevation[i][j] < min) min = block->elevation[i][j];
+			if(block->elevation[i][j] > max) max = block->elevation[i][j];
+		}
+	}
+	colormap_set_range(min, max);
+}
+
+
+
+/// this picks the palette that blocks are rendered with (one of the COLORMAP_PALETTE_ values).
+// the blocks are not re-rendered by this (see texture_cache_invalidate()).
+void colormap_select_palette(int palette){
+	if(!lutsBuilt){
+		error("colormap_select_palette() was called before colormap_init()");
+		return;
+	}
+	switch(palette){
+	case COLORMAP_PALETTE_RAW:
+		currentMap.mode = COLORMAP_RAW;
+		break;
+	case COLORMAP_PALETTE_TERRAIN:
+		currentMap.mode = COLORMAP_PALETTE;
+		currentMap.lut = terrainLut;
+		currentMap.lutSize = COLORMAP_LUT_SIZE;
+		break;
+	case COLORMAP_PALETTE_GRAY:
+		currentMap.mode = COLORMAP_GRAY;
+		break;
+	case COLORMAP_PALETTE_HEAT:
+		currentMap.mode = COLORMAP_PALETTE;
+		currentMap.lut = heatLut;
+		currentMap.lutSize = COLORMAP_LUT_SIZE;
+		break;
+	default:
+		error_d("colormap_select_palette() was sent an invalid palette. palette =", palette);
+		return;
+	}
+	currentPalette = palette;
+}
+
+
+
+/// this switches to the next palette (and back to the first one after the last).
+void colormap_next_palette(){
+	colormap_select_palette((currentPalette + 1) % COLORMAP_PALETTES);
+}
+
+
+
+/// returns the palette that is being used (one of the COLORMAP_PALETTE_ values).
+int colormap_get_palette(){
+	return currentPalette;
+}
@@ -0,0 +1,54 @@
+//#include "block.h"
+
+/// colormap definitions
+// a colormap turns a block's elevation data into the ARGB pixels of its texture.
+// the conversion is done by colormap_convert_block(). On x86 it uses SSE2 to convert 4x4 tiles of elevation at a time,
+// so the texture is written one row at a time even though elevation[][] is stored one column at a time.
+// the palettes (see colormap_select_palette()) are gradients that are turned into lookup tables once, when the program starts.
+// the elevation range they are spread over is fit to the world (see colormap_fit_range()).
+
+// these are the ways elevation can be turned into colors.
+// the elevation is used directly as an RGB color (this is how blocks have always been drawn).
+#define COLORMAP_RAW		0
+// the elevation is scaled from [min, max] to black through white. Anything outside of that range is clamped.
+#define COLORMAP_GRAY		1
+// the elevation is scaled from [min, max] to an index into a table of colors (lut). Anything outside of that range is clamped.
+#define COLORMAP_PALETTE	2
+
+/// this describes how to turn elevation into colors.
+struct colormap{
+	// this is one of the COLORMAP_ modes
+	short mode;
+	// this is the range of elevation that is spread out over the colors (for COLORMAP_GRAY and COLORMAP_PALETTE).
+	float min, max;
+	// this is the table of colors for COLORMAP_PALETTE. lut[0] is the color of min and lut[lutSize-1] is the color of max.
+	const Uint32 *lut;
+	int lutSize;
+};
+
+// this is how many colors are in each palette's lookup table.
+#define COLORMAP_LUT_SIZE		4096
+
+// these are the palettes that can be picked with colormap_select_palette().
+// the elevation is used directly as a color (the way blocks used to look).
+#define COLORMAP_PALETTE_RAW		0
+// deep water, shallow water, beach, grass, hills, rock, and snow from the lowest elevation of the world to the highest.
+#define COLORMAP_PALETTE_TERRAIN	1
+// black to white
+#define COLORMAP_PALETTE_GRAY		2
+// black, red, yellow, and then white
+#define COLORMAP_PALETTE_HEAT		3
+#define COLORMAP_PALETTES			4
+
+
+void colormap_convert_region(float elevation[BLOCK_WIDTH][BLOCK_HEIGHT], int x0, int y0, int x1, int y1, void *pixels, int pitch, const struct colormap *map);
+void colormap_convert_block(float elevation[BLOCK_WIDTH][BLOCK_HEIGHT], void *pixels, int pitch, const struct colormap *map);
+const struct colormap *colormap_current();
+void colormap_set_current(const struct colormap *map);
+
+void colormap_init();
+void colormap_set_range(float min, float max);
+void colormap_fit_range(struct blockData *block);
+void colormap_select_palette(int palette);
+void colormap_next_palette();
+int colormap_get_palette();
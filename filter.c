@@ -5,6 +5,7 @@
 #include <math.h>
 #include "utilities.h"
 #include "globals.h"
+#include "trace.h"
 
 
 
@@ -40,6 +41,8 @@
 	// the function will still filter and output the filtered signal as normal, but it will filter with the minimum tau value (FILTER_TAU_MINIMUM)
 short filter_lowpass_2D_f(float *x, float *y, long long int width, long long int height, float tau){
 	
+	TRACE_SCOPE("filter_lowpass_2D_f");
+	
 	//--------------------------------------------------
 	// checking for errors
 	//--------------------------------------------------
@@ -0,0 +1,131 @@
+#include <SDL2/SDL.h>
+#include "frame.h"
+#include "utilities.h"
+
+
+// this is the target frame rate. 0 means the frames are not capped.
+static int frameFps = FRAME_DEFAULT_FPS;
+// this is the earliest time the next frame can be presented.
+static Uint64 frameNext = 0;
+// this is set when something on the screen has changed and a frame needs to be drawn.
+static char framePending = 0;
+// this is when the pending frame was asked for.
+static Uint64 frameRequested = 0;
+
+// these count the frames that have been presented and dropped.
+static long long presentedCount = 0;
+static long long droppedCount = 0;
+// these are for reporting the dropped frames in the gamelog.
+static long long droppedReported = 0;
+static Uint64 lastReport = 0;
+
+
+
+/// returns how long one frame is (in performance counter ticks). 0 means the frames are not capped.
+static Uint64 frame_period(){
+	if(frameFps > 0) return SDL_GetPerformanceFrequency()/frameFps;
+	return 0;
+}
+
+
+
+/// this sets the target frame rate (frames per second).
+// 0 means the frames are not capped (a frame is presented as soon as something changes).
+void frame_set_fps(int fps){
+	if(fps < 0){
+		error_d("frame_set_fps() was sent a negative frame rate. fps =", fps);
+		fps = 0;
+	}
+	frameFps = fps;
+}
+
+
+
+/// returns the target frame rate (0 if the frames are not capped).
+int frame_get_fps(){
+	return frameFps;
+}
+
+
+
+/// this waits until there is something for the main loop to do.
+// if a frame is pending, this waits until it is time to present it (or until an event comes in, so that input is handled right away).
+// if nothing is pending, this waits for an event, but only for FRAME_IDLE_TIMEOUT_MS so that blocks the prefetcher linked in still get drawn.
+// the events are not taken off of the queue. The main loop still gets them with SDL_PollEvent().
+// don't hold the block lock when you call this (the prefetcher needs it while the main thread is asleep).
+void frame_wait(){
+	if(framePending){
+		Uint64 now = SDL_GetPerformanceCounter();
+		if(now >= frameNext) return;
+		// this is rounded up, so the main loop doesn't wake up just before the frame is due and spin until it is.
+		Uint64 frequency = SDL_GetPerformanceFrequency();
+		Uint64 ms = ((frameNext - now)*1000 + frequency - 1)/frequency;
+		SDL_WaitEventTimeout(NULL, (int)ms);
+	}
+	else{
+		SDL_WaitEventTimeout(NULL, FRAME_IDLE_TIMEOUT_MS);
+	}
+}
+
+
+
+/// this tells the frame pacer that something on the screen has changed, so a frame needs to be drawn.
+void frame_request(){
+	if(framePending) return;
+	framePending = 1;
+	frameRequested = SDL_GetPerformanceCounter();
+}
+
+
+
+/// returns 1 if a frame has been asked for and it is time to present it.
+// returns 0 otherwise (there is nothing new to draw, or the last frame was presented too recently).
+char frame_ready(){
+	if(!framePending) return 0;
+	return SDL_GetPerformanceCounter() >= frameNext;
+}
+
+
+
+/// call this right after a frame is presented.
+// this works out when the next frame can be presented and counts the frames that were dropped.
+void frame_presented(){
+
+	Uint64 now = SDL_GetPerformanceCounter();
+	Uint64 period = frame_period();
+	presentedCount++;
+	framePending = 0;
+
+	if(period > 0){
+		// this is when the frame should have been presented (it can't be before it was asked for).
+		Uint64 due = (frameRequested > frameNext) ? frameRequested : frameNext;
+		// every whole frame period it was late by is a frame that was dropped.
+		if(now > due) droppedCount += (now - due)/period;
+		// the next frame is one period after this one was due. If that has already gone by, it can be presented right away.
+		frameNext = due + period;
+		if(frameNext < now) frameNext = now;
+	}
+
+	// report the dropped frames every once in a while
+	if(now - lastReport >= FRAME_REPORT_INTERVAL*SDL_GetPerformanceFrequency()){
+		if(droppedCount > droppedReported){
+			gamelog_d("frame_presented() frames dropped since the last report:", (int)(droppedCount - droppedReported));
+			droppedReported = droppedCount;
+		}
+		lastReport = now;
+	}
+}
+
+
+
+/// returns the number of frames that have been presented.
+long long frame_presented_count(){
+	return presentedCount;
+}
+
+
+
+/// returns the number of frames that were dropped (presented more than one frame period late).
+long long frame_dropped_count(){
+	return droppedCount;
+}
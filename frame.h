@@ -0,0 +1,23 @@
+/// frame definitions
+// the main loop doesn't draw frames as fast as it can. It sleeps until something happens, and it only draws a frame when something on the screen has changed.
+// when nothing is happening, the main thread waits for an event (see frame_wait()), and it wakes up every once in a while to see if the prefetcher has linked in new blocks.
+// when something has changed, a frame is asked for (see frame_request()). The frames are spread out so that no more than the target frame rate are presented every second.
+// a frame that is presented more than one frame period after it was due counts as a dropped frame. The dropped frames are reported in the gamelog.
+// these are only used by the main thread.
+
+// this is the default target frame rate (frames per second).
+#define FRAME_DEFAULT_FPS			60
+// when there is nothing to draw, the main loop wakes up this often (in milliseconds) to see if anything changed in the background.
+#define FRAME_IDLE_TIMEOUT_MS		100
+// the number of dropped frames is written to the gamelog this often (in seconds), as long as some frames were dropped.
+#define FRAME_REPORT_INTERVAL		10
+
+
+void frame_set_fps(int fps);
+int frame_get_fps();
+void frame_wait();
+void frame_request();
+char frame_ready();
+void frame_presented();
+long long frame_presented_count();
+long long frame_dropped_count();
@@ -0,0 +1,308 @@
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <string.h>
+#include "frame_timer.h"
+#include "frame.h"
+#include "block.h"
+#include "block_pool.h"
+#include "utilities.h"
+
+
+// these are the time each stage has taken so far in the current frame (in performance counter ticks).
+static Uint64 stageTicks[FRAME_STAGES];
+// these are the stages that are running (the last one is the one being timed; the others are paused).
+static int stageStack[FRAME_TIMER_MAX_DEPTH];
+static int stageDepth = 0;
+// this is when the stage on top of the stack started (or started again).
+static Uint64 stageStart = 0;
+
+// this is the ring buffer of frames. next is where the next frame goes.
+static struct frameRecord history[FRAME_TIMER_HISTORY];
+static int historyNext = 0;
+static int historyCount = 0;
+// this is how many frames have been recorded since the program started.
+static long long recordedCount = 0;
+// this is when the first frame was recorded.
+static Uint64 timerEpoch = 0;
+// this is block_pool_allocated_count() when the last frame was recorded.
+static long long lastAllocated = 0;
+
+// this is set when the overlay is shown.
+static char overlayShown = 0;
+
+static const char *stageNames[FRAME_STAGES] = {"events", "camera", "network", "render", "cache", "present"};
+// these are the colors of the stages in the overlay (ARGB).
+static const Uint32 stageColors[FRAME_STAGES] = {0xffffa000, 0xffff3030, 0xffc040ff, 0xff30e030, 0xff30e0e0, 0xff4080ff};
+
+
+
+/// this starts timing stage (one of the FRAME_STAGE_ values).
+// if another stage is already running, it is paused until this one stops.
+void frame_timer_start(int stage){
+	if(stage < 0 || stage >= FRAME_STAGES){
+		error_d("frame_timer_start() was sent an invalid stage. stage =", stage);
+		return;
+	}
+	if(stageDepth >= FRAME_TIMER_MAX_DEPTH){
+		error_d("frame_timer_start() has too many stages running. stage =", stage);
+		return;
+	}
+	Uint64 now = SDL_GetPerformanceCounter();
+	if(stageDepth > 0) stageTicks[stageStack[stageDepth-1]] += now - stageStart;
+	stageStack[stageDepth++] = stage;
+	stageStart = now;
+}
+
+
+
+/// this stops timing stage. It has to be the last stage that was started.
+// the stage that was running before it (if there was one) starts again.
+void frame_timer_stop(int stage){
+	if(stageDepth <= 0 || stageStack[stageDepth-1] != stage){
+		error_d("frame_timer_stop() was sent a stage that isn't the one running. stage =", stage);
+		return;
+	}
+	Uint64 now = SDL_GetPerformanceCounter();
+	stageTicks[stage] += now - stageStart;
+	stageDepth--;
+	stageStart = now;
+}
+
+
+
+/// this records the frame that was just presented and starts a new one.
+void frame_timer_end_frame(){
+
+	Uint64 now = SDL_GetPerformanceCounter();
+	double ticksPerMs = SDL_GetPerformanceFrequency()/1000.0;
+	if(recordedCount == 0) timerEpoch = now;
+
+	struct frameRecord *record = &history[historyNext];
+	record->time = (now - timerEpoch)/ticksPerMs;
+	record->totalMs = 0;
+	int s;
+	for(s=0; s<FRAME_STAGES; s++){
+		record->stageMs[s] = stageTicks[s]/ticksPerMs;
+		record->totalMs += record->stageMs[s];
+		stageTicks[s] = 0;
+	}
+	long long allocated = block_pool_allocated_count();
+	record->blocksGenerated = (int)(allocated - lastAllocated);
+	lastAllocated = allocated;
+
+	historyNext = (historyNext + 1)%FRAME_TIMER_HISTORY;
+	if(historyCount < FRAME_TIMER_HISTORY) historyCount++;
+	recordedCount++;
+}
+
+
+
+/// returns one of the recorded frames. age 0 is the last frame, 1 is the one before it, and so on.
+// returns NULL if that frame isn't in the history (anymore).
+const struct frameRecord *frame_timer_record(int age){
+	if(age < 0 || age >= historyCount) return NULL;
+	return &history[(historyNext - 1 - age + FRAME_TIMER_HISTORY)%FRAME_TIMER_HISTORY];
+}
+
+
+
+/// returns the number of frames in the history.
+int frame_timer_count(){
+	return historyCount;
+}
+
+
+
+/// returns the name of a stage (one of the FRAME_STAGE_ values).
+const char *frame_timer_stage_name(int stage){
+	if(stage < 0 || stage >= FRAME_STAGES) return "invalid";
+	return stageNames[stage];
+}
+
+
+
+/// this shows the overlay if it is hidden, and hides it if it is shown.
+void frame_timer_toggle_overlay(){
+	overlayShown = !overlayShown;
+}
+
+
+
+/// returns 1 if the overlay is shown.
+char frame_timer_overlay_shown(){
+	return overlayShown;
+}
+
+
+
+//--------------------------------------------------
+// overlay
+//--------------------------------------------------
+
+// this is a tiny 3x5 pixel font for the overlay (there isn't a font library).
+// each glyph is 15 bits, one row of 3 at a time from the top. The highest bit is the upper left pixel.
+static const char overlayGlyphChars[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ.:-";
+static const Uint16 overlayGlyphs[] = {
+	0x7b6f, 0x2c97, 0x73e7, 0x73cf, 0x5bc9, 0x79cf, 0x79ef, 0x7249, 0x7bef, 0x7bcf,
+	0x2bed, 0x6bae, 0x3923, 0x6b6e, 0x79a7, 0x79a4, 0x396b, 0x5bed, 0x7497, 0x126a,
+	0x5bad, 0x4927, 0x5fed, 0x6b6d, 0x2b6a, 0x6ba4, 0x2b73, 0x6bad, 0x388e, 0x7492,
+	0x5b6f, 0x5b6a, 0x5bfd, 0x5aad, 0x5a92, 0x72a7, 0x0002, 0x0410, 0x01c0
+};
+
+// this is how big each pixel of the font is on the screen.
+#define FRAME_TIMER_FONT_SCALE	2
+// this is how far apart the lines of text are.
+#define FRAME_TIMER_LINE		(7*FRAME_TIMER_FONT_SCALE)
+// this is how tall the graph is, and how many pixels tall one millisecond is in it.
+#define FRAME_TIMER_GRAPH_H		96
+#define FRAME_TIMER_GRAPH_SCALE	3
+// this is the space around everything in the overlay.
+#define FRAME_TIMER_MARGIN		8
+
+
+/// this sets the draw color of renderer to an ARGB color.
+static void frame_timer_color(SDL_Renderer *renderer, Uint32 color){
+	SDL_SetRenderDrawColor(renderer, (color>>16)&0xff, (color>>8)&0xff, color&0xff, (color>>24)&0xff);
+}
+
+
+/// this draws text at (x, y) in the overlay font. Lower case letters are drawn as capitals, and anything the font doesn't have is a space.
+static void frame_timer_text(SDL_Renderer *renderer, int x, int y, const char *text, Uint32 color){
+	frame_timer_color(renderer, color);
+	SDL_Rect pixel = {0, 0, FRAME_TIMER_FONT_SCALE, FRAME_TIMER_FONT_SCALE};
+	for(; *text; text++, x += 4*FRAME_TIMER_FONT_SCALE){
+		char c = *text;
+		if(c >= 'a' && c <= 'z') c += 'A' - 'a';
+		const char *found = (c != '\0') ? strchr(overlayGlyphChars, c) : NULL;
+		if(found == NULL) continue;
+		Uint16 glyph = overlayGlyphs[found - overlayGlyphChars];
+		int bit;
+		for(bit=0; bit<15; bit++){
+			if(!(glyph & (1<<(14-bit)))) continue;
+			pixel.x = x + (bit%3)*FRAME_TIMER_FONT_SCALE;
+			pixel.y = y + (bit/3)*FRAME_TIMER_FONT_SCALE;
+			SDL_RenderFillRect(renderer, &pixel);
+		}
+	}
+}
+
+
+/// this draws the overlay in the upper left corner of renderer.
+// the graph shows how long each of the last FRAME_TIMER_HISTORY frames took (the stages are stacked on top of each other, the newest frame is on the right).
+// the line across the graph is how long a frame can take at the target frame rate.
+// under it are the times of the stages in the last frame, how many blocks were generated for it, and how many frames have been dropped.
+void frame_timer_draw(SDL_Renderer *renderer){
+
+	if(renderer == NULL){
+		error("frame_timer_draw() was sent NULL renderer. renderer = NULL");
+		return;
+	}
+
+	// the overlay shouldn't change how the rest of the program draws, so the draw color and blend mode are put back when it's done.
+	Uint8 r, g, b, a;
+	SDL_BlendMode blendMode;
+	SDL_GetRenderDrawColor(renderer, &r, &g, &b, &a);
+	SDL_GetRenderDrawBlendMode(renderer, &blendMode);
+	SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+
+	int x0 = FRAME_TIMER_MARGIN, y0 = FRAME_TIMER_MARGIN;
+	int width = FRAME_TIMER_HISTORY + 2*FRAME_TIMER_MARGIN;
+	int height = FRAME_TIMER_GRAPH_H + (FRAME_STAGES + 3)*FRAME_TIMER_LINE + 3*FRAME_TIMER_MARGIN;
+	SDL_Rect rect = {x0, y0, width, height};
+	frame_timer_color(renderer, 0xb0000000);
+	SDL_RenderFillRect(renderer, &rect);
+
+	// the graph
+	int graphX = x0 + FRAME_TIMER_MARGIN;
+	int graphBottom = y0 + FRAME_TIMER_MARGIN + FRAME_TIMER_GRAPH_H;
+	int age, s;
+	for(age=0; age<historyCount; age++){
+		const struct frameRecord *record = frame_timer_record(age);
+		int top = graphBottom;
+		rect.x = graphX + FRAME_TIMER_HISTORY - 1 - age;
+		rect.w = 1;
+		for(s=0; s<FRAME_STAGES && top > graphBottom - FRAME_TIMER_GRAPH_H; s++){
+			int h = (int)(record->stageMs[s]*FRAME_TIMER_GRAPH_SCALE + 0.5f);
+			if(h <= 0) continue;
+			if(top - h < graphBottom - FRAME_TIMER_GRAPH_H) h = top - (graphBottom - FRAME_TIMER_GRAPH_H);
+			rect.y = top - h;
+			rect.h = h;
+			frame_timer_color(renderer, stageColors[s]);
+			SDL_RenderFillRect(renderer, &rect);
+			top -= h;
+		}
+	}
+	if(frame_get_fps() > 0){
+		int budget = (int)(1000.0f/frame_get_fps()*FRAME_TIMER_GRAPH_SCALE);
+		if(budget < FRAME_TIMER_GRAPH_H){
+			rect.x = graphX;
+			rect.y = graphBottom - budget;
+			rect.w = FRAME_TIMER_HISTORY;
+			rect.h = 1;
+			frame_timer_color(renderer, 0x80ffffff);
+			SDL_RenderFillRect(renderer, &rect);
+		}
+	}
+
+	// the numbers
+	const struct frameRecord *last = frame_timer_record(0);
+	char line[64];
+	int y = graphBottom + FRAME_TIMER_MARGIN;
+	snprintf(line, sizeof(line), "frame %6.2f ms", last ? last->totalMs : 0.0f);
+	frame_timer_text(renderer, graphX, y, line, 0xffffffff);
+	y += FRAME_TIMER_LINE;
+	for(s=0; s<FRAME_STAGES; s++){
+		rect.x = graphX;
+		rect.y = y;
+		rect.w = rect.h = 5*FRAME_TIMER_FONT_SCALE;
+		frame_timer_color(renderer, stageColors[s]);
+		SDL_RenderFillRect(renderer, &rect);
+		snprintf(line, sizeof(line), "%-8s%6.2f ms", stageNames[s], last ? last->stageMs[s] : 0.0f);
+		frame_timer_text(renderer, graphX + 8*FRAME_TIMER_FONT_SCALE, y, line, 0xffffffff);
+		y += FRAME_TIMER_LINE;
+	}
+	snprintf(line, sizeof(line), "blocks %d", last ? last->blocksGenerated : 0);
+	frame_timer_text(renderer, graphX, y, line, 0xffffffff);
+	y += FRAME_TIMER_LINE;
+	snprintf(line, sizeof(line), "dropped %lld", frame_dropped_count());
+	frame_timer_text(renderer, graphX, y, line, 0xffffffff);
+
+	SDL_SetRenderDrawBlendMode(renderer, blendMode);
+	SDL_SetRenderDrawColor(renderer, r, g, b, a);
+}
+
+
+
+/// this writes the frames in the history to a CSV file (the oldest frame first).
+// returns 0 on success
+// returns 1 on NULL fileName
+// returns 2 if the file could not be opened
+short frame_timer_write_csv(const char *fileName){
+
+	if(fileName == NULL){
+		error("frame_timer_write_csv() was sent NULL fileName. fileName = NULL");
+		return 1;
+	}
+	FILE *fp = fopen(fileName, "w");
+	if(fp == NULL){
+		error("frame_timer_write_csv() could not open the file:");
+		error((char *)fileName);
+		return 2;
+	}
+
+	int age, s;
+	fprintf(fp, "frame,time_ms,total_ms");
+	for(s=0; s<FRAME_STAGES; s++) fprintf(fp, ",%s_ms", stageNames[s]);
+	fprintf(fp, ",blocks_generated\n");
+
+	for(age=historyCount-1; age>=0; age--){
+		const struct frameRecord *record = frame_timer_record(age);
+		fprintf(fp, "%lld,%.3f,%.3f", recordedCount - 1 - age, record->time, record->totalMs);
+		for(s=0; s<FRAME_STAGES; s++) fprintf(fp, ",%.3f", record->stageMs[s]);
+		fprintf(fp, ",%d\n", record->blocksGenerated);
+	}
+
+	fclose(fp);
+	gamelog_d("frame_timer_write_csv() wrote the frame times. frames =", historyCount);
+	return 0;
+}
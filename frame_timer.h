@@ -0,0 +1,53 @@
+/// frame timer definitions
+// the frame timer measures how long each stage of the main loop takes (see the FRAME_STAGE_ values).
+// a stage is timed by calling frame_timer_start() before it and frame_timer_stop() after it. Stages can be started inside of other stages.
+// the time spent in the inner stage is only counted for the inner stage (the outer stage is paused until the inner one stops).
+// the times are added up until a frame is presented. Then they are recorded (see frame_timer_end_frame()).
+// the time the main loop spends asleep (see frame_wait()) isn't part of any stage, so it isn't counted.
+// the last FRAME_TIMER_HISTORY frames are kept in a ring buffer. They can be drawn on the screen (see frame_timer_draw()) or written to a CSV file (see frame_timer_write_csv()).
+// these are only used by the main thread.
+
+// these are the stages of the main loop.
+// handling the events from SDL_PollEvent()
+#define FRAME_STAGE_EVENTS		0
+// moving the camera and generating the blocks it needs (camera_check(), camera_pan(), and the keys that edit or generate blocks)
+#define FRAME_STAGE_CAMERA		1
+// drawing the network hierarchy and presenting the network viewer
+#define FRAME_STAGE_NETWORK		2
+// drawing the map (camera_render()) and the overlay
+#define FRAME_STAGE_RENDER		3
+// telling the prefetcher where the camera is and evicting old blocks
+#define FRAME_STAGE_CACHE		4
+// presenting the map (SDL_RenderPresent())
+#define FRAME_STAGE_PRESENT		5
+#define FRAME_STAGES			6
+
+// this is how many frames are kept.
+#define FRAME_TIMER_HISTORY		256
+// this is how deep stages can be started inside of each other.
+#define FRAME_TIMER_MAX_DEPTH	8
+
+/// this is what is recorded for each frame.
+struct frameRecord{
+	// this is when the frame was presented (milliseconds since the program started).
+	double time;
+	// this is how long each stage took in milliseconds.
+	float stageMs[FRAME_STAGES];
+	// this is all of the stages added together.
+	float totalMs;
+	// this is how many blocks were generated (by anyone) since the last frame.
+	int blocksGenerated;
+};
+
+
+void frame_timer_start(int stage);
+void frame_timer_stop(int stage);
+void frame_timer_end_frame();
+const struct frameRecord *frame_timer_record(int age);
+int frame_timer_count();
+const char *frame_timer_stage_name(int stage);
+
+void frame_timer_toggle_overlay();
+char frame_timer_overlay_shown();
+void frame_timer_draw(SDL_Renderer *renderer);
+short frame_timer_write_csv(const char *fileName);
@@ -3,7 +3,6 @@
 // global display stuff
 SDL_Window *myWindow;
 SDL_Renderer *myRenderer;
-SDL_Texture *myTexture;
 
 // global event stuff
 SDL_Event event;
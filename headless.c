@@ -0,0 +1,235 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+#include "block.h"
+#include "block_cache.h"
+#include "camera.h"
+#include "colormap.h"
+#include "headless.h"
+#include "texture_cache.h"
+#include "utilities.h"
+
+
+// these are the file extensions of the HEADLESS_FORMAT_ values.
+static const char *headlessExtensions[] = {"png", "bmp", "raw"};
+
+
+
+/// this fills options with the default headless options (a single frame of the origin written to frame_0000.png).
+void headless_default_options(struct headlessOptions *options){
+	if(options == NULL) return;
+	memset(options, 0, sizeof(struct headlessOptions));
+	options->width = HEADLESS_DEFAULT_WIDTH;
+	options->height = HEADLESS_DEFAULT_HEIGHT;
+	options->output = "frame_";
+	options->format = HEADLESS_FORMAT_PNG;
+}
+
+
+
+/// this writes surface to a file in one of the HEADLESS_FORMAT_ formats.
+// returns 0 on success
+// returns 1 on NULL surface or fileName
+// returns 2 on an invalid format
+// returns 3 if the file could not be written
+short headless_save_surface(SDL_Surface *surface, const char *fileName, short format){
+
+	if(surface == NULL || fileName == NULL){
+		error("headless_save_surface() was sent a NULL surface or fileName.");
+		return 1;
+	}
+
+	int ret = 0;
+	switch(format){
+	case HEADLESS_FORMAT_PNG:
+		ret = IMG_SavePNG(surface, fileName);
+		break;
+	case HEADLESS_FORMAT_BMP:
+		ret = SDL_SaveBMP(surface, fileName);
+		break;
+	case HEADLESS_FORMAT_RAW:{
+		FILE *fp = fopen(fileName, "wb");
+		if(fp == NULL){
+			ret = -1;
+			break;
+		}
+		// the rows are written one at a time so that the padding at the end of each row (if there is any) is left out.
+		int j;
+		for(j=0; j<surface->h && ret == 0; j++){
+			if(fwrite((Uint8 *)surface->pixels + j*surface->pitch, surface->format->BytesPerPixel, surface->w, fp) != (size_t)surface->w) ret = -1;
+		}
+		fclose(fp);
+		break;
+	}
+	default:
+		error_d("headless_save_surface() was sent an invalid format. format =", format);
+		return 2;
+	}
+
+	if(ret){
+		error("headless_save_surface() could not write the file:");
+		error((char *)fileName);
+		return 3;
+	}
+	return 0;
+}
+
+
+
+/// this draws the camera's view on renderer and writes it to the next frame file.
+// returns 0 on success
+// returns 1 if the frame could not be drawn or written
+static short headless_frame(SDL_Renderer *renderer, SDL_Surface *surface, struct cameraData *cam, const struct headlessOptions *options, int *frame){
+
+	// start a new frame for the block cache
+	block_cache_tick();
+	SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+	SDL_RenderClear(renderer);
+	// there is no prefetcher in headless mode, and every frame has to be complete, so the blocks on the screen are generated first.
+	if(camera_generate_view(renderer, cam)) return 1;
+	if(camera_render(renderer, cam)) return 1;
+	SDL_RenderPresent(renderer);
+	// free the blocks that haven't been used in a while if there are too many of them.
+	block_cache_evict();
+
+	char fileName[1024];
+	snprintf(fileName, sizeof(fileName), "%s%04d.%s", options->output, *frame, headlessExtensions[options->format]);
+	if(headless_save_surface(surface, fileName, options->format)) return 1;
+	(*frame)++;
+	return 0;
+}
+
+
+
+/// this runs one command of the script (see headless.h), writing a frame after every step of it.
+// returns 0 on success
+// returns 1 if the command wasn't understood
+// returns 2 if the camera couldn't do what the command said
+// returns 3 if a frame could not be drawn or written
+static short headless_command(char *command, SDL_Renderer *renderer, SDL_Surface *surface, struct cameraData *cam, const struct headlessOptions *options, int *frame){
+
+	char name[16];
+	float a = 0, b = 0;
+	long long level, addressX, addressY;
+	int repeat = 1, i;
+	int args = sscanf(command, "%15s", name);
+	// empty commands (like the one after a semicolon at the end of the script) don't do anything.
+	if(args < 1) return 0;
+
+	// the frame is the same size as the longer side, so this is how many elements of the target block each pixel is at a scale of 1.
+	float elementsPerPixel = BLOCK_WIDTH/(float)(options->width > options->height ? options->width : options->height);
+
+	if(strcmp(name, "zoom") == 0){
+		if(sscanf(command, "%*s %f %d", &a, &repeat) < 1 || a <= 0) return 1;
+		if(repeat < 1 || repeat > HEADLESS_MAX_REPEAT) return 1;
+		for(i=0; i<repeat; i++){
+			cam->scale /= a;
+			if(camera_check(cam)) return 2;
+			if(headless_frame(renderer, surface, cam, options, frame)) return 3;
+		}
+	}
+	else if(strcmp(name, "pan") == 0){
+		if(sscanf(command, "%*s %f %f %d", &a, &b, &repeat) < 2) return 1;
+		if(repeat < 1 || repeat > HEADLESS_MAX_REPEAT) return 1;
+		for(i=0; i<repeat; i++){
+			cam->x += a*elementsPerPixel*cam->scale;
+			cam->y += b*elementsPerPixel*cam->scale;
+			if(camera_check(cam)) return 2;
+			if(headless_frame(renderer, surface, cam, options, frame)) return 3;
+		}
+	}
+	else if(strcmp(name, "go") == 0){
+		if(sscanf(command, "%*s %lld %lld %lld", &level, &addressX, &addressY) < 3) return 1;
+		if(camera_go_to(cam, level, addressX, addressY, BLOCK_WIDTH_1_2, BLOCK_HEIGHT_1_2)) return 2;
+		if(headless_frame(renderer, surface, cam, options, frame)) return 3;
+	}
+	else if(strcmp(name, "palette") == 0){
+		if(sscanf(command, "%*s %d", &i) < 1 || i < 0 || i >= COLORMAP_PALETTES) return 1;
+		colormap_select_palette(i);
+		// all of the blocks need to be drawn again with the new colors.
+		texture_cache_invalidate();
+		if(headless_frame(renderer, surface, cam, options, frame)) return 3;
+	}
+	else if(strcmp(name, "shot") == 0){
+		if(headless_frame(renderer, surface, cam, options, frame)) return 3;
+	}
+	else{
+		return 1;
+	}
+	return 0;
+}
+
+
+
+/// this renders the camera's views into memory and writes them to disk (see headless.h). No windows are opened.
+// the block network and the camera need to be set up already (the way main() does it).
+// returns 0 on success
+// returns 1 on NULL cam or options
+// returns 2 if the frame surface or its renderer could not be created
+// returns 3 if the camera could not go to the start address
+// returns 4 if there is something wrong with the script
+// returns 5 if a frame could not be drawn or written
+short headless_run(struct cameraData *cam, const struct headlessOptions *options){
+
+	if(cam == NULL || options == NULL){
+		error("headless_run() was sent a NULL cam or options.");
+		return 1;
+	}
+	if(options->width <= 0 || options->height <= 0 || options->format < HEADLESS_FORMAT_PNG || options->format > HEADLESS_FORMAT_RAW){
+		error("headless_run() was sent invalid options (the size or the format).");
+		return 1;
+	}
+
+	// the frames are drawn on a surface in memory by a software renderer.
+	// the texture cache makes its textures with this renderer, so the blocks are drawn exactly the way they are in the window.
+	SDL_Surface *surface = create_surface(options->width, options->height);
+	SDL_Renderer *renderer = (surface != NULL) ? SDL_CreateSoftwareRenderer(surface) : NULL;
+	if(renderer == NULL){
+		error("headless_run() could not create the frame surface or its software renderer.");
+		if(surface != NULL) SDL_FreeSurface(surface);
+		return 2;
+	}
+
+	short ret = 0;
+	int frame = 0;
+
+	if(options->start && camera_go_to(cam, options->startLevel, options->startX, options->startY, BLOCK_WIDTH_1_2, BLOCK_HEIGHT_1_2)){
+		error("headless_run() could not move the camera to the start address.");
+		ret = 3;
+	}
+	// the first frame is the view the camera starts with.
+	else if(headless_frame(renderer, surface, cam, options, &frame)){
+		ret = 5;
+	}
+	else if(options->script != NULL){
+		// the script is split up into commands on a copy (strtok() writes into the string).
+		char *script = malloc(strlen(options->script) + 1);
+		if(script == NULL){
+			error("headless_run() could not allocate memory for the script. script = NULL");
+			ret = 4;
+		}
+		else{
+			strcpy(script, options->script);
+			char *command;
+			for(command = strtok(script, ";"); command != NULL && ret == 0; command = strtok(NULL, ";")){
+				short result = headless_command(command, renderer, surface, cam, options, &frame);
+				if(result){
+					error("headless_run() could not run the script command:");
+					error(command);
+					ret = (result == 3) ? 5 : 4;
+				}
+			}
+			free(script);
+		}
+	}
+
+	gamelog_d("headless_run() frames written:", frame);
+
+	// the block textures belong to the software renderer, so they go first.
+	texture_cache_clean_up();
+	SDL_DestroyRenderer(renderer);
+	SDL_FreeSurface(surface);
+	return ret;
+}
@@ -0,0 +1,47 @@
+//#include "camera.h"
+
+/// headless definitions
+// the headless mode renders camera views into memory (an SDL_Surface with a software renderer) without opening any windows.
+// it is started with --headless on the command line. The camera can be sent to an address with --start, and then moved around with a script (--script).
+// a frame is written to disk after every step of the script (or just one frame if there is no script), so it can be used to make thumbnails,
+// or to check that the rendering hasn't changed (or gotten slower) on a computer that doesn't have a display.
+//
+// the script is a list of commands separated by semicolons. For example: "zoom 3; pan 100 0 10; palette 2"
+//	zoom F [N]		zooms in by a factor of F (F < 1 zooms out). This is done N times (1 by default), and a frame is written each time.
+//	pan DX DY [N]	moves the camera DX pixels right and DY pixels down (the pixels of the frame). This is done N times (1 by default).
+//	go L X Y		moves the camera to the center of the block at the address (L, X, Y) (see "Block Addresses" in block.h).
+//	palette P		switches to palette P (one of the COLORMAP_PALETTE_ values).
+//	shot			just writes another frame.
+
+// these are the formats the frames can be written in.
+#define HEADLESS_FORMAT_PNG		0
+#define HEADLESS_FORMAT_BMP		1
+// the pixels are written as they are (4 bytes per pixel, ARGB8888 in the computer's byte order, one row after another with no header).
+#define HEADLESS_FORMAT_RAW		2
+
+// this is the default size of the frames.
+#define HEADLESS_DEFAULT_WIDTH	(BLOCK_WIDTH*3)
+#define HEADLESS_DEFAULT_HEIGHT	(BLOCK_HEIGHT*3)
+// this is the most times a single command can be repeated.
+#define HEADLESS_MAX_REPEAT		10000
+
+/// this is everything the headless mode needs to know (it comes from the command line).
+struct headlessOptions{
+	// this is the size of the frames in pixels.
+	int width, height;
+	// if this is set, the camera starts at the center of the block at the address (startLevel, startX, startY).
+	char start;
+	signed long long startLevel;
+	long long startX, startY;
+	// this is the script of camera moves. It can be NULL.
+	const char *script;
+	// the frames are written to files with this name followed by the frame number (and the extension of the format).
+	const char *output;
+	// this is one of the HEADLESS_FORMAT_ values.
+	short format;
+};
+
+
+void headless_default_options(struct headlessOptions *options);
+short headless_save_surface(SDL_Surface *surface, const char *fileName, short format);
+short headless_run(struct cameraData *cam, const struct headlessOptions *options);
@@ -0,0 +1,345 @@
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <string.h>
+#include "logger.h"
+#include "utilities.h"
+
+
+/// this is one line in the ring buffer.
+struct loggerLine{
+	short level;
+	char text[LOGGER_LINE_SIZE];
+};
+
+/// this keeps track of how often one message has been logged lately (see logger_admit()).
+struct loggerRate{
+	// this is the hash of the message's text. 0 means the slot isn't being used.
+	Uint32 hash;
+	// this is the message itself (so it can be named when the repeats are reported).
+	char message[LOGGER_LINE_SIZE/2];
+	short level;
+	// this is when the current window started (SDL_GetTicks()).
+	Uint32 windowStart;
+	// this is how many times the message was logged in this window, and how many of those were thrown away.
+	int count;
+	int suppressed;
+};
+
+
+// this protects everything below it. Nothing is done while holding it except copying a line, so a spin lock is good enough.
+static SDL_SpinLock loggerLock = 0;
+// this is the ring buffer. The oldest line is at ringStart.
+static struct loggerLine ring[LOGGER_RING_SIZE];
+static int ringStart = 0;
+static int ringCount = 0;
+// these are the rate limits of the messages that have been logged lately.
+static struct loggerRate rates[LOGGER_RATE_SLOTS];
+// this is how many lines were thrown away because the ring buffer was full, and how many of those haven't been reported in the log yet.
+static long long droppedCount = 0;
+static long long droppedUnreported = 0;
+// this is how many lines were thrown away by the rate limit.
+static long long suppressedCount = 0;
+
+// messages below this level are thrown away.
+static short loggerLevel = LOGGER_LEVEL_INFO;
+
+// this is the logger thread. It is NULL when lines are written straight to the files.
+static SDL_Thread *loggerThread = NULL;
+// the logger thread waits on this. It is posted when the ring buffer needs to be written sooner than LOGGER_FLUSH_INTERVAL_MS.
+static SDL_sem *loggerWake = NULL;
+// this is set to 1 to tell the logger thread to quit.
+static SDL_atomic_t loggerQuit;
+
+// these are the files the logger thread keeps open.
+static FILE *errorFile = NULL;
+static FILE *gamelogFile = NULL;
+
+
+
+/// this writes a line to its file, using the files that the logger thread keeps open.
+static void logger_output(short level, const char *text){
+	FILE *fp = (level >= LOGGER_LEVEL_ERROR) ? errorFile : gamelogFile;
+	if(fp != NULL) fputs(text, fp);
+}
+
+
+
+/// this writes a line to its file when the logger thread isn't running. The file is opened and closed again just for this line.
+// loggerLock must NOT be locked when this is called (so other threads don't spin while the file is opened).
+static void logger_output_direct(short level, const char *text){
+	FILE *fp = (level >= LOGGER_LEVEL_ERROR) ? fopen(ERROR_FILE, ERROR_FILE_MODE) : fopen(GAMELOG_FILE, GAMELOG_FILE_MODE);
+	if(fp != NULL){
+		fputs(text, fp);
+		fclose(fp);
+	}
+}
+
+
+
+/// this puts a line into the ring buffer.
+// loggerLock must be locked when this is called.
+// if the logger thread isn't running, whoever pushed the line writes it out with logger_write_direct() after letting go of the lock.
+// returns 1 if the logger thread should be woken up (the line is an error or the ring buffer is filling up)
+static int logger_push(short level, const char *text){
+
+	if(ringCount >= LOGGER_RING_SIZE){
+		droppedCount++;
+		droppedUnreported++;
+		return 1;
+	}
+	struct loggerLine *line = &ring[(ringStart + ringCount)%LOGGER_RING_SIZE];
+	line->level = level;
+	strncpy(line->text, text, LOGGER_LINE_SIZE-1);
+	line->text[LOGGER_LINE_SIZE-1] = '\0';
+	ringCount++;
+	return level >= LOGGER_LEVEL_ERROR || ringCount >= LOGGER_RING_SIZE/2;
+}
+
+
+
+/// this writes out the lines in the ring buffer when the logger thread isn't running.
+// each line is copied out with loggerLock held and written after the lock is let go.
+// if the logger thread is running, this does nothing (the lines are the logger thread's to write).
+static void logger_write_direct(){
+
+	struct loggerLine line;
+	while(1){
+		SDL_AtomicLock(&loggerLock);
+		if(loggerThread != NULL || ringCount == 0){
+			SDL_AtomicUnlock(&loggerLock);
+			return;
+		}
+		line = ring[ringStart];
+		ringStart = (ringStart+1)%LOGGER_RING_SIZE;
+		ringCount--;
+		SDL_AtomicUnlock(&loggerLock);
+
+		logger_output_direct(line.level, line.text);
+	}
+}
+
+
+
+/// this logs how many times the message in rate was thrown away (if it was thrown away at all).
+// loggerLock must be locked when this is called.
+// returns 1 if the logger thread should be woken up
+static int logger_report_suppressed(struct loggerRate *rate){
+	if(rate->hash == 0 || rate->suppressed == 0) return 0;
+	// the report goes in the same file as the message.
+	char text[LOGGER_LINE_SIZE];
+	if(rate->level >= LOGGER_LEVEL_ERROR) snprintf(text, sizeof(text), ERROR_FORMAT_D, ERROR_TIMESTAMP, "logger: this message was repeated too often. It was left out this many times:", rate->suppressed);
+	else snprintf(text, sizeof(text), GAMELOG_FORMAT_D, GAMELOG_TIMESTAMP, "logger: this message was repeated too often. It was left out this many times:", rate->suppressed);
+	int wake = logger_push(rate->level, text);
+	if(rate->level >= LOGGER_LEVEL_ERROR) snprintf(text, sizeof(text), ERROR_FORMAT, ERROR_TIMESTAMP, rate->message);
+	else snprintf(text, sizeof(text), GAMELOG_FORMAT, GAMELOG_TIMESTAMP, rate->message);
+	wake |= logger_push(rate->level, text);
+	rate->suppressed = 0;
+	return wake;
+}
+
+
+
+/// this decides if a message can be logged, or if it has been logged too often lately.
+// loggerLock must be locked when this is called.
+// returns 1 if the message can be logged
+// returns 0 if it should be thrown away
+static int logger_admit(short level, const char *message, int *wake){
+
+	// FNV-1a hash of the message
+	Uint32 hash = 2166136261u;
+	const char *c;
+	for(c=message; *c; c++) hash = (hash ^ (Uint8)*c)*16777619u;
+	if(hash == 0) hash = 1;
+
+	struct loggerRate *rate = &rates[hash%LOGGER_RATE_SLOTS];
+	Uint32 now = SDL_GetTicks();
+	// a different message was using this slot. Its repeats are reported before it is forgotten.
+	if(rate->hash != hash){
+		*wake |= logger_report_suppressed(rate);
+		rate->hash = hash;
+		strncpy(rate->message, message, sizeof(rate->message)-1);
+		rate->message[sizeof(rate->message)-1] = '\0';
+		rate->level = level;
+		rate->windowStart = now;
+		rate->count = 0;
+	}
+	// start a new window
+	else if(now - rate->windowStart >= LOGGER_RATE_WINDOW_MS){
+		*wake |= logger_report_suppressed(rate);
+		rate->windowStart = now;
+		rate->count = 0;
+	}
+
+	if(rate->count >= LOGGER_RATE_LIMIT){
+		rate->suppressed++;
+		suppressedCount++;
+		return 0;
+	}
+	rate->count++;
+	return 1;
+}
+
+
+
+/// this logs a line that has already been formatted (with its timestamp and newline).
+// message is the part of the line that the rate limit looks at (the text without the data).
+// while the logger thread is running, this never waits on the disk. It can be called from any thread.
+// when it isn't running, the line is written to its file after loggerLock is let go.
+void logger_write(short level, const char *message, const char *line){
+
+	if(level < loggerLevel || line == NULL) return;
+	if(message == NULL) message = line;
+
+	int wake = 0;
+	SDL_AtomicLock(&loggerLock);
+	if(logger_admit(level, message, &wake)) wake |= logger_push(level, line);
+	int direct = (loggerThread == NULL);
+	SDL_AtomicUnlock(&loggerLock);
+
+	if(direct) logger_write_direct();
+	else if(wake && loggerWake != NULL) SDL_SemPost(loggerWake);
+}
+
+
+
+/// this writes everything in the ring buffer to the files.
+// only the logger thread calls this (and logger_quit() after the logger thread is done).
+static void logger_drain(){
+
+	// the lines are copied out a few at a time, so loggerLock is only held for as long as it takes to copy them.
+	static struct loggerLine batch[32];
+	int count, i;
+	long long dropped;
+	do{
+		SDL_AtomicLock(&loggerLock);
+		count = 0;
+		while(ringCount > 0 && count < 32){
+			batch[count++] = ring[ringStart];
+			ringStart = (ringStart+1)%LOGGER_RING_SIZE;
+			ringCount--;
+		}
+		dropped = droppedUnreported;
+		droppedUnreported = 0;
+		SDL_AtomicUnlock(&loggerLock);
+
+		for(i=0; i<count; i++) logger_output(batch[i].level, batch[i].text);
+		if(dropped && gamelogFile != NULL) fprintf(gamelogFile, GAMELOG_FORMAT_D, GAMELOG_TIMESTAMP, "logger: the ring buffer was full. lines dropped =", (int)dropped);
+	}while(count > 0);
+
+	if(errorFile != NULL) fflush(errorFile);
+	if(gamelogFile != NULL) fflush(gamelogFile);
+}
+
+
+
+/// this is what the logger thread runs.
+static int logger_thread(void *unused){
+
+	(void)unused;
+	while(!SDL_AtomicGet(&loggerQuit)){
+		SDL_SemWaitTimeout(loggerWake, LOGGER_FLUSH_INTERVAL_MS);
+		logger_drain();
+	}
+	return 0;
+}
+
+
+
+/// this opens the log files and starts the logger thread.
+// returns 0 on success
+// returns 1 if the logger was already started
+// returns 2 if the files could not be opened or the thread could not be started (the lines are written straight to the files instead)
+short logger_init(){
+
+	if(loggerThread != NULL){
+		error("logger_init() was called twice.");
+		return 1;
+	}
+
+	errorFile = fopen(ERROR_FILE, ERROR_FILE_MODE);
+	gamelogFile = fopen(GAMELOG_FILE, GAMELOG_FILE_MODE);
+	loggerWake = SDL_CreateSemaphore(0);
+	SDL_AtomicSet(&loggerQuit, 0);
+	// loggerThread is set under the lock so that no line is pushed into the ring buffer while it is being set (or written straight to a file after it is set).
+	SDL_AtomicLock(&loggerLock);
+	if(errorFile != NULL && gamelogFile != NULL && loggerWake != NULL){
+		loggerThread = SDL_CreateThread(logger_thread, "logger", NULL);
+	}
+	SDL_AtomicUnlock(&loggerLock);
+
+	if(loggerThread == NULL){
+		if(errorFile != NULL) fclose(errorFile);
+		if(gamelogFile != NULL) fclose(gamelogFile);
+		if(loggerWake != NULL) SDL_DestroySemaphore(loggerWake);
+		errorFile = gamelogFile = NULL;
+		loggerWake = NULL;
+		error("logger_init() could not open the log files or start the logger thread. Lines will be written straight to the files.");
+		return 2;
+	}
+	return 0;
+}
+
+
+
+/// this stops the logger thread and writes out everything that is left (including how many times the rate limited messages were left out).
+// after this, lines are written straight to the files again.
+void logger_quit(){
+
+	if(loggerThread == NULL) return;
+
+	int r;
+	SDL_AtomicLock(&loggerLock);
+	for(r=0; r<LOGGER_RATE_SLOTS; r++) logger_report_suppressed(&rates[r]);
+	SDL_AtomicUnlock(&loggerLock);
+
+	SDL_AtomicSet(&loggerQuit, 1);
+	SDL_SemPost(loggerWake);
+	SDL_WaitThread(loggerThread, NULL);
+	// anything logged after the thread's last drain is still in the ring buffer.
+	logger_drain();
+
+	SDL_AtomicLock(&loggerLock);
+	loggerThread = NULL;
+	SDL_AtomicUnlock(&loggerLock);
+	fclose(errorFile);
+	fclose(gamelogFile);
+	errorFile = gamelogFile = NULL;
+	SDL_DestroySemaphore(loggerWake);
+	loggerWake = NULL;
+}
+
+
+
+/// this sets the lowest level of message that gets logged (one of the LOGGER_LEVEL_ values).
+void logger_set_level(short level){
+	if(level < LOGGER_LEVEL_DEBUG) level = LOGGER_LEVEL_DEBUG;
+	if(level > LOGGER_LEVEL_ERROR) level = LOGGER_LEVEL_ERROR;
+	loggerLevel = level;
+}
+
+
+
+/// returns the lowest level of message that gets logged.
+short logger_get_level(){
+	return loggerLevel;
+}
+
+
+
+/// returns the number of lines that were thrown away because the ring buffer was full.
+long long logger_dropped_count(){
+	SDL_AtomicLock(&loggerLock);
+	long long count = droppedCount;
+	SDL_AtomicUnlock(&loggerLock);
+	return count;
+}
+
+
+
+/// returns the number of lines that were thrown away by the rate limit.
+long long logger_suppressed_count(){
+	SDL_AtomicLock(&loggerLock);
+	long long count = suppressedCount;
+	SDL_AtomicUnlock(&loggerLock);
+	return count;
+}
@@ -0,0 +1,39 @@
+/// logger definitions
+// the logger is what error() and gamelog() (see utilities.h) write through.
+// every line is formatted right away (so the timestamp is when it happened), put into a ring buffer in memory, and written to its file later by the logger thread.
+// the logger thread keeps the files open and writes whatever is in the ring buffer every LOGGER_FLUSH_INTERVAL_MS (or sooner if the buffer is filling up).
+// so the thread that logs something never waits on the disk. If the ring buffer is full, the line is dropped (and counted) instead of waiting for room.
+//
+// the same message can only be logged LOGGER_RATE_LIMIT times every LOGGER_RATE_WINDOW_MS. The rest are counted, and how many there were is logged afterwards.
+// (messages are the same if they have the same text, not counting the data that goes with them)
+//
+// before logger_init() (and after logger_quit()), or if the logger thread couldn't be started, the lines are written straight to their files the way they always were.
+
+// these are the levels of the messages. Messages below the level set with logger_set_level() are thrown away.
+#define LOGGER_LEVEL_DEBUG		0
+#define LOGGER_LEVEL_INFO		1
+#define LOGGER_LEVEL_WARNING	2
+// error messages go to the error file. Everything else goes to the gamelog.
+#define LOGGER_LEVEL_ERROR		3
+#define LOGGER_LEVELS			4
+
+// this is how many lines the ring buffer holds.
+#define LOGGER_RING_SIZE		1024
+// this is the longest a line can be (including the newline). Longer lines are cut off.
+#define LOGGER_LINE_SIZE		256
+// the logger thread writes what is in the ring buffer at least this often (in milliseconds).
+#define LOGGER_FLUSH_INTERVAL_MS	250
+// this is how many times the same message can be logged in each window (LOGGER_RATE_WINDOW_MS milliseconds).
+#define LOGGER_RATE_LIMIT		5
+#define LOGGER_RATE_WINDOW_MS	1000
+// this is how many different messages the rate limit keeps track of at once.
+#define LOGGER_RATE_SLOTS		64
+
+
+short logger_init();
+void logger_quit();
+void logger_set_level(short level);
+short logger_get_level();
+void logger_write(short level, const char *message, const char *line);
+long long logger_dropped_count();
+long long logger_suppressed_count();
@@ -1,6 +1,7 @@
 #include <SDL2/SDL.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "utilities.h"
 #include "block.h"
 #include "camera.h"
@@ -13,6 +14,18 @@
 #include "sprites.h"
 #include "generation.h"
 #include "tree_generation.h"
+#include "block_cache.h"
+#include "worker.h"
+#include "prefetch.h"
+#include "texture_cache.h"
+#include "colormap.h"
+#include "block_mip.h"
+#include "frame.h"
+#include "frame_timer.h"
+#include "headless.h"
+#include "trace.h"
+#include "logger.h"
+#include "block_stats.h"
 
 
 
@@ -34,6 +47,95 @@ int main(int argc, char *argv[]){
 	}
 	gamelog("END ARGV LIST");
 	
+	//--------------------------------------------------
+	// command line options
+	//--------------------------------------------------
+	// the world is different every time unless a seed is given with --seed
+	block_set_world_seed((unsigned long long)time(NULL));
+	// this is how many worker threads generate blocks. 0 means one for every CPU except this one.
+	int workerThreads = 0;
+	// --headless renders frames to files instead of opening any windows (see headless.h).
+	char headless = 0;
+	struct headlessOptions headlessOpts;
+	headless_default_options(&headlessOpts);
+	for(arg=1; arg<argc; arg++){
+		// --seed N generates the world from a specific seed (the same seed always generates the same world)
+		if(strcmp(argv[arg], "--seed") == 0 && arg+1 < argc){
+			block_set_world_seed(strtoull(argv[++arg], NULL, 10));
+		}
+		// --max-blocks N limits how many blocks are kept in memory (0 = no limit)
+		else if(strcmp(argv[arg], "--max-blocks") == 0 && arg+1 < argc){
+			block_cache_set_max_blocks(atoll(argv[++arg]));
+		}
+		// --max-memory MB limits how much memory the blocks can use (0 = no limit)
+		else if(strcmp(argv[arg], "--max-memory") == 0 && arg+1 < argc){
+			block_cache_set_max_bytes(atoll(argv[++arg])*1024LL*1024LL);
+		}
+		// --max-textures N limits how many block textures are kept
+		else if(strcmp(argv[arg], "--max-textures") == 0 && arg+1 < argc){
+			texture_cache_set_max_textures(atoi(argv[++arg]));
+		}
+		// --max-texture-memory MB limits how much texture memory the blocks can use
+		else if(strcmp(argv[arg], "--max-texture-memory") == 0 && arg+1 < argc){
+			texture_cache_set_max_bytes(atoll(argv[++arg])*1024LL*1024LL);
+		}
+		// --fps N caps how many frames are presented every second (0 = no cap)
+		else if(strcmp(argv[arg], "--fps") == 0 && arg+1 < argc){
+			frame_set_fps(atoi(argv[++arg]));
+		}
+		// --log-level N only logs messages at level N and above (0 = debug, 1 = info, 2 = warnings, 3 = errors)
+		else if(strcmp(argv[arg], "--log-level") == 0 && arg+1 < argc){
+			logger_set_level(atoi(argv[++arg]));
+		}
+		// --threads N sets how many worker threads generate blocks (0 = one per extra CPU)
+		else if(strcmp(argv[arg], "--threads") == 0 && arg+1 < argc){
+			workerThreads = atoi(argv[++arg]);
+		}
+		// --headless renders the camera to files without opening any windows
+		else if(strcmp(argv[arg], "--headless") == 0){
+			headless = 1;
+		}
+		// --size W H sets the size of the headless frames
+		else if(strcmp(argv[arg], "--size") == 0 && arg+2 < argc){
+			headlessOpts.width = atoi(argv[++arg]);
+			headlessOpts.height = atoi(argv[++arg]);
+		}
+		// --start LEVEL X Y starts the headless camera at the center of the block at that address
+		else if(strcmp(argv[arg], "--start") == 0 && arg+3 < argc){
+			headlessOpts.start = 1;
+			headlessOpts.startLevel = strtoll(argv[++arg], NULL, 10);
+			headlessOpts.startX = strtoll(argv[++arg], NULL, 10);
+			headlessOpts.startY = strtoll(argv[++arg], NULL, 10);
+		}
+		// --script "COMMANDS" moves the headless camera around (see headless.h)
+		else if(strcmp(argv[arg], "--script") == 0 && arg+1 < argc){
+			headlessOpts.script = argv[++arg];
+		}
+		// --output PREFIX is the start of the headless frame file names
+		else if(strcmp(argv[arg], "--output") == 0 && arg+1 < argc){
+			headlessOpts.output = argv[++arg];
+		}
+		// --format png|bmp|raw is the file format of the headless frames
+		else if(strcmp(argv[arg], "--format") == 0 && arg+1 < argc){
+			arg++;
+			if(strcmp(argv[arg], "png") == 0)		headlessOpts.format = HEADLESS_FORMAT_PNG;
+			else if(strcmp(argv[arg], "bmp") == 0)	headlessOpts.format = HEADLESS_FORMAT_BMP;
+			else if(strcmp(argv[arg], "raw") == 0)	headlessOpts.format = HEADLESS_FORMAT_RAW;
+			else{
+				error(argv[arg]);
+				error("main() did not recognize the above frame format.");
+			}
+		}
+		else{
+			error(argv[arg]);
+			error("main() did not recognize the above command line argument.");
+		}
+	}
+	// record the seed so that this world can be visited again.
+	char seedMessage[64];
+	sprintf(seedMessage, "main() world seed = %llu", block_get_world_seed());
+	gamelog(seedMessage);
+	
 	windW = BLOCK_WIDTH*3;
 	windH = BLOCK_HEIGHT*3;
 	//--------------------------------------------------
@@ -47,70 +149,82 @@ int main(int argc, char *argv[]){
 	SDL_Texture *spriteTexture = NULL;
 	myWindow = NULL;
 	myRenderer = NULL;
-	myTexture = NULL;
 	
 	SDL_Window *networkWindow = NULL;
 	SDL_Renderer *networkRenderer = NULL;
 	SDL_Texture *networkTexture = NULL;
 	SDL_Surface *networkSurface = NULL;
+	// this is what the network viewer was last drawn with (see block_graph_version()).
+	unsigned long networkVersion = 0;
+	struct blockData *networkHighlight = NULL;
+	unsigned int networkW = 0, networkH = 0;
 	
 	sgenrand(time(NULL));
 	
 	
-	if(SDL_Init(SDL_INIT_EVERYTHING) == -1) return -99;
+	// the headless mode doesn't need the video subsystem (there might not even be a display).
+	if(SDL_Init(headless ? SDL_INIT_TIMER : SDL_INIT_EVERYTHING) == -1) return -99;
+	
+	// from here on, logging is done by the logger thread (see logger.h).
+	logger_init();
+	// SIGUSR1 writes the block stats to the gamelog
+	block_stats_catch_signal();
+	
+	// start recording the trace (if tracing was compiled in, see trace.h). This has to be done before any other threads start.
+	TRACE_INIT(TRACE_DEFAULT_FILE);
+	TRACE_THREAD_NAME("main");
+	
+	// start the threads that generate blocks
+	worker_init(workerThreads);
+	// the main thread and the prefetcher share the block network, so it needs a lock.
+	block_lock_init();
 	
+	if(!headless){
 		// set network window
-	networkWindow = SDL_CreateWindow("FractalMap - Network Viewer", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, windW, windH, SDL_WINDOW_RESIZABLE);
-	networkRenderer = SDL_CreateRenderer(networkWindow, -1, 0);
+		networkWindow = SDL_CreateWindow("FractalMap - Network Viewer", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, windW, windH, SDL_WINDOW_RESIZABLE);
+		networkRenderer = SDL_CreateRenderer(networkWindow, -1, 0);
 	
-	if(networkWindow == NULL){
-		error("main() could not create networkWindow using SDL_CreateWindow");
-		return -1;
-	}
-	if(networkRenderer == NULL){
-		error("main() could not create networkRenderer using SDL_CreateRenderer");
-		return -2;
-	}
+		if(networkWindow == NULL){
+			error("main() could not create networkWindow using SDL_CreateWindow");
+			return -1;
+		}
+		if(networkRenderer == NULL){
+			error("main() could not create networkRenderer using SDL_CreateRenderer");
+			return -2;
+		}
 	
 	
-	myWindow = SDL_CreateWindow("FractalMap - Map", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, windW, windH, SDL_WINDOW_RESIZABLE);
-	myRenderer = SDL_CreateRenderer(myWindow, -1, 0);
+		myWindow = SDL_CreateWindow("FractalMap - Map", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, windW, windH, SDL_WINDOW_RESIZABLE);
+		myRenderer = SDL_CreateRenderer(myWindow, -1, 0);
 	
-	if(myWindow == NULL){
-		error("main() could not create window using SDL_CreateWindow");
-		return -1;
-	}
-	if(myRenderer == NULL){
-		error("main() could not create renderer using SDL_CreateRenderer");
-		return -2;
-	}
+		if(myWindow == NULL){
+			error("main() could not create window using SDL_CreateWindow");
+			return -1;
+		}
+		if(myRenderer == NULL){
+			error("main() could not create renderer using SDL_CreateRenderer");
+			return -2;
+		}
 	
 	
-	SDL_SetRenderDrawColor(networkRenderer, 0, 0, 0, 255);
-	SDL_RenderClear(networkRenderer);
-	SDL_RenderPresent(networkRenderer);
+		SDL_SetRenderDrawColor(networkRenderer, 0, 0, 0, 255);
+		SDL_RenderClear(networkRenderer);
+		SDL_RenderPresent(networkRenderer);
 	
-	SDL_SetRenderDrawColor(myRenderer, 0, 0, 0, 255);
-	SDL_RenderClear(myRenderer);
-	SDL_RenderPresent(myRenderer);
+		SDL_SetRenderDrawColor(myRenderer, 0, 0, 0, 255);
+		SDL_RenderClear(myRenderer);
+		SDL_RenderPresent(myRenderer);
+	}
 	
 	//SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "linear"); // make the scaled rendering look smoother
 	//SDL_RenderSetLogicalSize(myRenderer, windW, windH);
 	
-	myTexture = SDL_CreateTexture(myRenderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, windW, windH);
+	// the blocks are drawn with streaming textures from the texture cache (see texture_cache.h).
+	// build the palettes that turn elevation into colors.
+	colormap_init();
 	
 	//SDL_Texture *glider = load_image_to_texture("glider.jpg");
 	
-	if(myTexture == NULL){
-		error("main() could not create texture using SDL_CreateTexture");
-		return -2;
-	}
-	
-	if(myTexture == NULL){
-		error("main() could not create glider texture using SDL_CreateTexture");
-		return -2;
-	}
-	
 	//--------------------------------------------------
 	// blocks and cameras
 	//--------------------------------------------------
@@ -123,6 +237,21 @@ int main(int argc, char *argv[]){
 	struct cameraData *camera = camera_create(origin);
 	block_generate_parent(origin);
 	block_generate_parent(origin->parent);
+	// the network viewer always starts drawing from origin->parent, so the origin must never be evicted.
+	block_cache_pin(origin);
+	// spread the palette over the elevation of this world.
+	// (the origin is used because the parents are averages of their children, so their elevation doesn't go as high or as low).
+	colormap_fit_range(origin);
+	
+	// the headless mode draws its frames and quits (see headless.h).
+	if(headless){
+		short headlessRet = headless_run(camera, &headlessOpts);
+		clean_up();
+		return headlessRet;
+	}
+	
+	// start generating the blocks around the camera in the background.
+	prefetch_init();
 	
 	//--------------------------------------------------
 	// event handling
@@ -138,16 +267,33 @@ int main(int argc, char *argv[]){
 	int i;
 	// these keep track of where the mouse is
 	int x, y;
+	// this is what the map was last drawn with. A frame is only drawn when one of these changes (or something else happens, see frame.h).
+	struct blockData *drawnTarget = NULL;
+	float drawnX = 0, drawnY = 0, drawnScale = 0;
+	unsigned long drawnVersion = 0;
 	
 	
 	while(quit == 0){
 		
+		// sleep until there is something to do (see frame.h)
+		frame_wait();
+		
+		// the main thread holds the block lock while it uses the block network.
+		// it only lets go while it is asleep and while the frame is being presented. That is when the prefetcher gets to link in the blocks it has generated.
+		block_lock();
+		
+		// start a new frame for the block cache
+		block_cache_tick();
+		
 		// reset all keystroke values
 		for(i=0; i<keysSize; i++){
 			keys[i] = 0;
 		}
 		
+		frame_timer_start(FRAME_STAGE_EVENTS);
 		while(SDL_PollEvent(&event)){
+			// anything that happens (except the mouse moving around) might change what is on the screen.
+			if(event.type != SDL_MOUSEMOTION) frame_request();
 			// if there is a mouse button down event,
 			if(event.type == SDL_MOUSEBUTTONDOWN){
 				//down++;
@@ -156,12 +302,17 @@ int main(int argc, char *argv[]){
 				//down--;
 			}
 			else if(event.type == SDL_MOUSEWHEEL){
+				// the prefetcher uses the wheel to predict fast zooms
+				prefetch_wheel(event.wheel.y);
 				// for each time the user scrolls in, increase the zoom by some factor
 				for(i=0; i<abs(event.wheel.y); i++){
 					if(event.wheel.y < 0)	{camera->scale *= 1.129830964f;}	// the user is moving the mouse wheel "down" or towards himself/herself.
 					else					{camera->scale /= 1.129830964f;}	// the user is rotating the mouse wheel "up" or away from himself/herself.
-					camera_check(camera);
 				}
+				// the camera goes straight to the level all the notches end up on (it doesn't stop on every level in between).
+				frame_timer_start(FRAME_STAGE_CAMERA);
+				camera_check(camera);
+				frame_timer_stop(FRAME_STAGE_CAMERA);
 			}
 			else if(event.type == SDL_MOUSEMOTION){
 				x = event.motion.x;
@@ -189,6 +340,26 @@ int main(int argc, char *argv[]){
 				quit = 1;
 			}
 		}
+		frame_timer_stop(FRAME_STAGE_EVENTS);
+		
+		// the h key shows or hides the frame timing overlay
+		if(keys['h']){
+			frame_timer_toggle_overlay();
+		}
+		
+		// the o key writes the times of the last frames to a CSV file
+		if(keys['o']){
+			if(frame_timer_write_csv("frame_times.csv") == 0) gamelog("main() wrote the frame times to frame_times.csv");
+		}
+		
+		// the i key (or SIGUSR1) writes the block stats (memory use, generation, and eviction) to the gamelog
+		if(keys['i'] || block_stats_requested()){
+			struct blockStats stats;
+			block_stats_collect(&stats);
+			block_stats_print(&stats);
+		}
+		
+		frame_timer_start(FRAME_STAGE_CAMERA);
 		
 		// the wasd keys are used currently for testing the generation of neighbors.
 		if(keys['w']){
@@ -208,10 +379,21 @@ int main(int argc, char *argv[]){
 			camera_pan(camera, CAMERA_PAN_RIGHT);
 		}
 		
+		// the m key switches to the next palette. All of the blocks need to be drawn again with the new colors.
+		if(keys['m']){
+			colormap_next_palette();
+			texture_cache_invalidate();
+			gamelog_d("main() switched to palette", colormap_get_palette());
+		}
+		
 		// if the user pressed the r key
 		if(keys['r']){
-			// generate random noise in the block
-			block_random_fill(camera->target, 0, 0xffffff);
+			// undo any edits. A block with children is built from them again (see block_mip.h).
+			// a block without children gets its random noise again (this is always the same noise for the same block).
+			camera->target->edited = 0;
+			if((camera->target)->children[0] != NULL) block_mip_build(camera->target);
+			else block_random_fill(camera->target, 0, 0xffffff);
+			block_mip_update(camera->target);
 		}
 		
 		// if the user pressed the c key
@@ -223,6 +405,9 @@ int main(int argc, char *argv[]){
 		// fill up the left half of the screen with a color
 		if(keys['v']){
 			block_fill_half_vert(camera->target, 0xffffffff, 0);
+			// the block cache won't throw away an edited block (see block_cache.h).
+			camera->target->edited = 1;
+			block_mip_update(camera->target);
 		}
 		
 		// generate parent of camera->target if the p key is pressed
@@ -242,6 +427,11 @@ int main(int argc, char *argv[]){
 			
 			// the f key is for filtering
 			if(keys['f']) filter_lowpass_2D_f((float *)((camera->target)->elevation), NULL, BLOCK_WIDTH, BLOCK_HEIGHT, 3); // using the low-pass filter
+			
+			// the block needs to be drawn again, and the parents show the changed block too
+			camera->target->edited = 1;
+			block_mark_all_dirty(camera->target);
+			block_mip_update(camera->target);
 		}
 		
 		
@@ -294,6 +484,8 @@ int main(int argc, char *argv[]){
 			spriteTexture = SDL_CreateTextureFromSurface(myRenderer, spriteSurface);
 		}
 		
+		frame_timer_stop(FRAME_STAGE_CAMERA);
+		
 		
 		//draw_rect(mapSurface, 243, 243, x-243, y-243, 9, color_mix_weighted(0xff00ff00,0xff0000ff,1,1), 0, 0);
 		// block_generate_neighbor(camera->target, BLOCK_NEIGHBOR_UP);
@@ -306,33 +498,88 @@ int main(int argc, char *argv[]){
 		
 		
 		
-		// clear the old texture if it exists
-		if(networkSurface != NULL)SDL_FreeSurface(networkSurface);
+		// a frame is needed if the camera moved, or blocks were linked into the network (or taken out of it) since the last frame.
+		if(camera->target != drawnTarget || camera->x != drawnX || camera->y != drawnY || camera->scale != drawnScale || block_graph_version() != drawnVersion){
+			frame_request();
+		}
+		// the frames are only drawn when something changed, and no faster than the target frame rate (see frame.h).
+		char drawFrame = frame_ready();
+		
+		if(drawFrame){
+			frame_timer_start(FRAME_STAGE_NETWORK);
+			// the network hierarchy is only drawn again when blocks were added to or removed from the network, the camera moved to a different block, or the window changed size.
+			// otherwise the texture from last time is still right.
+			if(networkSurface == NULL || networkW != windW || networkH != windH || networkVersion != block_graph_version() || networkHighlight != camera->target){
+			
+				// the surface and texture are only made again when the window changes size
+				if(networkSurface == NULL || networkW != windW || networkH != windH){
+					if(networkSurface != NULL)SDL_FreeSurface(networkSurface);
+					if(networkTexture != NULL)SDL_DestroyTexture(networkTexture);
+					networkSurface = create_surface(windW, windH);
+					networkTexture = SDL_CreateTexture(networkRenderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, windW, windH);
+					networkW = windW;
+					networkH = windH;
+				}
+			
+				if(networkSurface != NULL && networkTexture != NULL){
+					// generate the network hierarchy
+					SDL_FillRect(networkSurface, NULL, 0x00000000);
+					block_print_network_hierarchy(networkSurface, origin->parent, camera->target, 5, 5, 0, 0, windW, 0xff00ff00, 0xff0000ff, 0xffff0000);
+					// copy it into the texture for the block network
+					SDL_UpdateTexture(networkTexture, NULL, networkSurface->pixels, networkSurface->pitch);
+				}
+				networkVersion = block_graph_version();
+				networkHighlight = camera->target;
+			}
+			// render the network texture to the networkWindow
+			if(networkTexture != NULL)SDL_RenderCopy(networkRenderer, networkTexture, NULL, NULL);
 		
-		networkSurface = create_surface(windW, windH);
+			// display the renderer's result on the screen and clear it when done
+			SDL_RenderPresent(networkRenderer);
+			SDL_RenderClear(networkRenderer);
+			frame_timer_stop(FRAME_STAGE_NETWORK);
 		
-		// generate the network hierarchy
-		block_print_network_hierarchy(networkSurface, origin->parent, camera->target, 5, 5, 0, 0, windW, 0xff00ff00, 0xff0000ff, 0xffff0000);
-		// generate texture for the block network
-		networkTexture = SDL_CreateTextureFromSurface(networkRenderer, networkSurface);
-		// render the networkSurface to the networkWindow
-		SDL_RenderCopy(networkRenderer, networkTexture, NULL, NULL);
-		if(networkTexture != NULL)SDL_DestroyTexture(networkTexture);
 		
-		// display the renderer's result on the screen and clear it when done
-		SDL_RenderPresent(networkRenderer);
-		SDL_RenderClear(networkRenderer);
 		
+			frame_timer_start(FRAME_STAGE_RENDER);
+			// print the camera to screen
+			camera_render(myRenderer,camera);
+			// print the test sprite to the screen
+			SDL_RenderCopy(myRenderer, spriteTexture, NULL, NULL);
+			// print the frame timing overlay on top of everything
+			if(frame_timer_overlay_shown()) frame_timer_draw(myRenderer);
+			frame_timer_stop(FRAME_STAGE_RENDER);
+			
+			drawnTarget = camera->target;
+			drawnX = camera->x;
+			drawnY = camera->y;
+			drawnScale = camera->scale;
+			drawnVersion = block_graph_version();
+			
+			// free the blocks that haven't been used in a while if there are too many of them.
+			// this is only done right after drawing, so the blocks that are on the screen have just been touched (see block_cache_touch()).
+			frame_timer_start(FRAME_STAGE_CACHE);
+			block_cache_evict();
+			frame_timer_stop(FRAME_STAGE_CACHE);
+		}
 		
+		// tell the prefetcher where the camera is so it can generate the blocks around it.
+		frame_timer_start(FRAME_STAGE_CACHE);
+		prefetch_update(camera);
+		frame_timer_stop(FRAME_STAGE_CACHE);
 		
-		// print the camera to screen
-		camera_render(myRenderer,camera);
-		// print the test sprite to the screen
-		SDL_RenderCopy(myRenderer, spriteTexture, NULL, NULL);
+		block_unlock();
 		
-		// display the renderer's result on the screen and clear it when done
-		SDL_RenderPresent(myRenderer);
-		SDL_RenderClear(myRenderer);
+		if(drawFrame){
+			// display the renderer's result on the screen and clear it when done
+			frame_timer_start(FRAME_STAGE_PRESENT);
+			SDL_RenderPresent(myRenderer);
+			SDL_RenderClear(myRenderer);
+			frame_timer_stop(FRAME_STAGE_PRESENT);
+			frame_presented();
+			// record how long each stage took this frame
+			frame_timer_end_frame();
+		}
 		
 	}
 	
@@ -343,6 +590,9 @@ int main(int argc, char *argv[]){
 	SDL_FreeSurface(mapSurface);
 	if(mapTexture != NULL)SDL_DestroyTexture(mapTexture);
 	if(networkTexture != NULL)SDL_DestroyTexture(networkTexture);
+	if(networkSurface != NULL)SDL_FreeSurface(networkSurface);
+	gamelog_d("main() frames presented:", (int)frame_presented_count());
+	gamelog_d("main() frames dropped:", (int)frame_dropped_count());
 	// clean up all SDL subsystems and other non-SDL systems and global memory.
 	clean_up();
 	
@@ -0,0 +1,577 @@
+#include "block.h"
+#include "camera.h"
+#include "prefetch.h"
+#include "block_cache.h"
+#include "block_pool.h"
+#include "utilities.h"
+#include "trace.h"
+#include <math.h>
+#include <string.h>
+
+
+/// this is what the prefetcher has been asked to do.
+// it is worked out from the camera's position and how the camera has been moving (see prefetch_update()).
+struct prefetchPlan{
+	// this is the block the camera is looking at.
+	struct blockData *target;
+	// these are the neighbor directions the camera is heading in (most likely first). -1 means there is no direction.
+	short pan[2];
+	// this is how many neighbors the camera is expected to cross in each of those directions (1 or 2).
+	int panSteps[2];
+	// this is the path of children the camera is expected to zoom into (dive[0] is the child of the target, dive[1] is the child of that child, ...).
+	char dive[PREFETCH_MAX_LEVELS];
+	int diveDepth;
+	// this is how many levels the camera is expected to zoom out.
+	int climb;
+};
+
+
+// this protects the request variables below (and nothing else).
+// if both locks are needed, the block lock always has to be locked first.
+static SDL_mutex *prefetchMutex = NULL;
+// the prefetcher waits on this until there is something to do.
+static SDL_cond *prefetchWake = NULL;
+static SDL_Thread *prefetchThread = NULL;
+// this is what the prefetcher should be doing right now.
+static struct prefetchPlan request;
+// this goes up by one every time the plan changes (the camera moves to a different target or starts moving a different way).
+// the prefetcher uses it to know when the work it is doing is out of date.
+static unsigned long requestNumber = 0;
+// this is set to 1 to tell the prefetcher to quit.
+static int prefetchQuit = 0;
+// this is how many blocks the prefetcher has generated.
+static long long prefetchedCount = 0;
+
+// these track how the camera has been moving. They are only used by the main thread (in prefetch_update() and prefetch_wheel()).
+// the camera's last position
+static struct blockData *lastTarget = NULL;
+static float lastX, lastY, lastZoom;
+// these are the camera's average velocities (in elements per frame and levels per frame).
+static float velocityX = 0, velocityY = 0, velocityZoom = 0;
+// this is how many mouse wheel notches have been turned since the last frame.
+static int wheelNotches = 0;
+
+
+/// returns 1 if the prefetcher should stop what it is doing (the camera moved on or the program is closing).
+static int prefetch_cancelled(unsigned long number){
+	SDL_LockMutex(prefetchMutex);
+	int cancelled = prefetchQuit || number != requestNumber;
+	SDL_UnlockMutex(prefetchMutex);
+	return cancelled;
+}
+
+
+
+/// this builds the children of block and publishes them.
+// block must be pinned by the caller (it is unpinned here). The block lock must NOT be held.
+static void prefetch_build_children(struct blockData *block){
+
+	struct blockData *children[BLOCK_CHILDREN];
+	int c;
+	for(c=0; c<BLOCK_CHILDREN; c++){
+		children[c] = NULL;
+	}
+
+	// this is the slow part. It is done without the lock.
+	short ret = block_build_children(block, children);
+
+	block_lock();
+	if(ret == 0) prefetchedCount += block_publish_children(block, children);
+	block_cache_unpin(block);
+	block_unlock();
+}
+
+
+
+/// this builds the parent of block (and the parent's other eight children) and publishes them.
+// block must be pinned by the caller (it is unpinned here). The block lock must NOT be held.
+static void prefetch_build_parent(struct blockData *block){
+
+	struct blockData *siblings[BLOCK_CHILDREN];
+	int c;
+	for(c=0; c<BLOCK_CHILDREN; c++){
+		siblings[c] = NULL;
+	}
+	siblings[BLOCK_CHILD_CENTER_CENTER] = block;
+
+	// this is the slow part. It is done without the lock.
+	struct blockData *newParent = block_build_parent(block);
+	if(newParent != NULL && block_build_children(newParent, siblings)){
+		block_pool_free(newParent);
+		newParent = NULL;
+	}
+
+	block_lock();
+	if(newParent != NULL && block_publish_parent(block, newParent, siblings) == 0) prefetchedCount += BLOCK_CHILDREN;
+	block_cache_unpin(block);
+	block_unlock();
+}
+
+
+
+/// this makes sure that block has its children.
+// the block lock must NOT be held. block must be pinned by the caller.
+static void prefetch_children(struct blockData *block){
+	block_lock();
+	if(block->children[0] != NULL){
+		block_unlock();
+		return;
+	}
+	block_cache_pin(block);
+	block_unlock();
+	prefetch_build_children(block);
+}
+
+
+
+/// this makes sure that block has its parent.
+// the block lock must NOT be held. block must be pinned by the caller.
+static void prefetch_parent(struct blockData *block){
+	block_lock();
+	if(block->parent != NULL){
+		block_unlock();
+		return;
+	}
+	block_cache_pin(block);
+	block_unlock();
+	prefetch_build_parent(block);
+}
+
+
+
+/// this makes sure that the neighbor of dat exists and is linked to dat.
+// the blocks on the way to the neighbor are found from the neighbor's address (see block_locate()) and generated one level at a time.
+// the block lock must NOT be held. dat must be pinned by the caller.
+// returns 0 when the neighbor is there
+// returns 1 if the prefetcher was cancelled or dat is too deep to have an address (the main thread will generate that neighbor)
+static short prefetch_neighbor(struct blockData *dat, short neighbor, unsigned long number){
+
+	struct blockData *need;
+
+	while(!prefetch_cancelled(number)){
+
+		block_lock();
+		if(dat->neighbors[neighbor] != NULL){
+			block_unlock();
+			return 0;
+		}
+		if(!dat->addressValid){
+			block_unlock();
+			return 1;
+		}
+
+		long long x = dat->addressX;
+		long long y = dat->addressY;
+		switch(neighbor){
+		case BLOCK_NEIGHBOR_UP:		y--; break;
+		case BLOCK_NEIGHBOR_DOWN:	y++; break;
+		case BLOCK_NEIGHBOR_LEFT:	x--; break;
+		case BLOCK_NEIGHBOR_RIGHT:	x++; break;
+		default:
+			block_unlock();
+			error_d("prefetch_neighbor() was sent an invalid neighbor direction. neighbor =", neighbor);
+			return 1;
+		}
+
+		switch(block_locate(dat->level, x, y, &need)){
+		case BLOCK_LOCATE_FOUND:
+			// everything is there, so this just links the neighbor to dat.
+			block_generate_neighbor(dat, neighbor);
+			block_unlock();
+			return 0;
+		case BLOCK_LOCATE_NEED_PARENT:
+			block_cache_pin(need);
+			block_unlock();
+			prefetch_build_parent(need);
+			break;
+		case BLOCK_LOCATE_NEED_CHILDREN:
+			block_cache_pin(need);
+			block_unlock();
+			prefetch_build_children(need);
+			break;
+		default:
+			block_unlock();
+			return 1;
+		}
+	}
+
+	return 1;
+}
+
+
+
+/// this zooms into the children of target along the path in dive[], generating each level's children on the way down.
+// target must be pinned by the caller.
+// returns 0 when the whole path is there
+// returns 1 if the prefetcher was cancelled
+static short prefetch_dive(struct blockData *target, char *dive, int depth, unsigned long number){
+
+	struct blockData *probe = target;
+	struct blockData *next;
+	int d;
+
+	block_lock();
+	block_cache_pin(probe);
+	block_unlock();
+
+	for(d=0; d<depth; d++){
+		if(prefetch_cancelled(number)) break;
+		prefetch_children(probe);
+		// step down to the next block on the path (and keep it pinned while its children are being generated).
+		block_lock();
+		next = probe->children[(int)dive[d]];
+		if(next != NULL) block_cache_pin(next);
+		block_cache_unpin(probe);
+		block_unlock();
+		if(next == NULL) return 1;
+		probe = next;
+	}
+
+	block_lock();
+	block_cache_unpin(probe);
+	block_unlock();
+
+	return d < depth;
+}
+
+
+
+/// this generates levels parents above target.
+// target must be pinned by the caller.
+// returns 0 when all of the parents are there
+// returns 1 if the prefetcher was cancelled
+static short prefetch_climb(struct blockData *target, int levels, unsigned long number){
+
+	struct blockData *probe = target;
+	struct blockData *next;
+	int l;
+
+	block_lock();
+	block_cache_pin(probe);
+	block_unlock();
+
+	for(l=0; l<levels; l++){
+		if(prefetch_cancelled(number)) break;
+		prefetch_parent(probe);
+		block_lock();
+		next = probe->parent;
+		if(next != NULL) block_cache_pin(next);
+		block_cache_unpin(probe);
+		block_unlock();
+		if(next == NULL) return 1;
+		probe = next;
+	}
+
+	block_lock();
+	block_cache_unpin(probe);
+	block_unlock();
+
+	return l < levels;
+}
+
+
+
+/// this generates the neighbor of dat that is steps blocks away in the neighbor direction.
+// dat must be pinned by the caller.
+// returns 0 when the neighbors are there
+// returns 1 if the prefetcher was cancelled
+static short prefetch_pan(struct blockData *dat, short neighbor, int steps, unsigned long number){
+
+	struct blockData *probe = dat;
+	struct blockData *next;
+	int s;
+	short ret = 0;
+
+	block_lock();
+	block_cache_pin(probe);
+	block_unlock();
+
+	for(s=0; s<steps && !ret; s++){
+		ret = prefetch_neighbor(probe, neighbor, number);
+		block_lock();
+		next = probe->neighbors[neighbor];
+		if(next != NULL) block_cache_pin(next);
+		block_cache_unpin(probe);
+		block_unlock();
+		if(next == NULL) return 1;
+		probe = next;
+	}
+
+	block_lock();
+	block_cache_unpin(probe);
+	block_unlock();
+
+	return ret;
+}
+
+
+
+/// this generates everything in plan (in the order that it is most likely to be needed).
+// the predicted path comes first. Then the blocks all the way around the target are filled in, in case the camera changes its mind.
+// plan->target must be pinned by the caller.
+static void prefetch_around(struct prefetchPlan *plan, unsigned long number){
+
+	struct blockData *target = plan->target;
+	int n;
+
+	// where the camera is heading
+	for(n=0; n<2; n++){
+		if(plan->pan[n] >= 0 && prefetch_pan(target, plan->pan[n], plan->panSteps[n], number)) return;
+	}
+	if(plan->diveDepth > 0 && prefetch_dive(target, plan->dive, plan->diveDepth, number)) return;
+	if(plan->climb > 0 && prefetch_climb(target, plan->climb, number)) return;
+
+	// the four neighbors
+	for(n=0; n<BLOCK_NEIGHBORS; n++){
+		if(prefetch_neighbor(target, n, number)) return;
+	}
+
+	// zooming in and zooming out
+	if(prefetch_cancelled(number)) return;
+	prefetch_children(target);
+	if(prefetch_cancelled(number)) return;
+	prefetch_parent(target);
+
+	// the four diagonal neighbors are the left and right neighbors of the up and down neighbors.
+	short upDown[2] = {BLOCK_NEIGHBOR_UP, BLOCK_NEIGHBOR_DOWN};
+	int d;
+	for(d=0; d<2; d++){
+		block_lock();
+		struct blockData *side = target->neighbors[upDown[d]];
+		if(side != NULL) block_cache_pin(side);
+		block_unlock();
+		if(side == NULL) continue;
+
+		short ret = prefetch_neighbor(side, BLOCK_NEIGHBOR_LEFT, number);
+		if(!ret) ret = prefetch_neighbor(side, BLOCK_NEIGHBOR_RIGHT, number);
+
+		block_lock();
+		block_cache_unpin(side);
+		block_unlock();
+		if(ret) return;
+	}
+
+	// zooming out twice
+	prefetch_climb(target, 2, number);
+}
+
+
+
+/// this is what the prefetch thread runs.
+static int prefetch_thread(void *unused){
+
+	(void)unused;
+	unsigned long handled = 0;
+	unsigned long number;
+	struct prefetchPlan plan;
+	TRACE_THREAD_NAME("prefetch");
+
+	while(1){
+
+		// wait for the camera to move to a new target
+		SDL_LockMutex(prefetchMutex);
+		while(!prefetchQuit && requestNumber == handled){
+			SDL_CondWait(prefetchWake, prefetchMutex);
+		}
+		int quit = prefetchQuit;
+		SDL_UnlockMutex(prefetchMutex);
+		if(quit) break;
+
+		// get the plan and pin its target so that it can't be evicted while the prefetcher is working around it.
+		// the target is always used by the camera in the frame it was requested in, so it can't have been evicted yet.
+		block_lock();
+		SDL_LockMutex(prefetchMutex);
+		plan = request;
+		number = requestNumber;
+		SDL_UnlockMutex(prefetchMutex);
+		if(plan.target != NULL) block_cache_pin(plan.target);
+		block_unlock();
+
+		if(plan.target != NULL){
+			prefetch_around(&plan, number);
+			block_lock();
+			block_cache_unpin(plan.target);
+			block_unlock();
+		}
+
+		handled = number;
+	}
+
+	return 0;
+}
+
+
+
+/// this starts the prefetch thread.
+// block_lock_init() must be called before this.
+// returns 0 on success
+// returns 1 if the prefetcher was already started
+// returns 2 if the mutex or condition variable could not be created
+// returns 3 if the thread could not be started
+short prefetch_init(){
+
+	if(prefetchMutex != NULL){
+		error("prefetch_init() was called twice.");
+		return 1;
+	}
+
+	prefetchMutex = SDL_CreateMutex();
+	prefetchWake = SDL_CreateCond();
+	if(prefetchMutex == NULL || prefetchWake == NULL){
+		error("prefetch_init() could not create the prefetch mutex and condition variable.");
+		return 2;
+	}
+
+	prefetchQuit = 0;
+	memset(&request, 0, sizeof(request));
+	requestNumber = 0;
+	lastTarget = NULL;
+	prefetchThread = SDL_CreateThread(prefetch_thread, "prefetch", NULL);
+	if(prefetchThread == NULL){
+		error("prefetch_init() could not create the prefetch thread. prefetchThread = NULL");
+		return 3;
+	}
+
+	return 0;
+}
+
+
+
+/// this stops the prefetch thread and waits for it to finish.
+void prefetch_quit(){
+
+	if(prefetchMutex == NULL) return;
+
+	SDL_LockMutex(prefetchMutex);
+	prefetchQuit = 1;
+	SDL_CondSignal(prefetchWake);
+	SDL_UnlockMutex(prefetchMutex);
+
+	if(prefetchThread != NULL) SDL_WaitThread(prefetchThread, NULL);
+	prefetchThread = NULL;
+
+	gamelog_d("prefetch_quit() stopped the prefetcher. prefetchedCount =", (int)prefetchedCount);
+
+	SDL_DestroyCond(prefetchWake);
+	SDL_DestroyMutex(prefetchMutex);
+	prefetchWake = NULL;
+	prefetchMutex = NULL;
+}
+
+
+
+/// this tells the prefetcher that the mouse wheel was turned.
+// call this from the SDL_MOUSEWHEEL handler (notches is event.wheel.y).
+// a burst of wheel notches is taken as the camera's new zoom speed right away instead of being averaged in slowly.
+void prefetch_wheel(int notches){
+	wheelNotches += notches;
+}
+
+
+
+/// this works out where the camera is heading and puts that into plan.
+static void prefetch_predict(struct cameraData *cam, struct prefetchPlan *plan){
+
+	int n = 0;
+
+	// this is where the center of the camera is now, and where it will be in PREFETCH_HORIZON_FRAMES frames at the speed it is going.
+	float xahead = cam->x + velocityX*PREFETCH_HORIZON_FRAMES;
+	float yahead = cam->y + velocityY*PREFETCH_HORIZON_FRAMES;
+
+	// panning. The direction the camera will go farthest past the edge of the target comes first.
+	float xover = 0, yover = 0;
+	short xdir = -1, ydir = -1;
+	if(xahead < 0)					{xdir = BLOCK_NEIGHBOR_LEFT;	xover = -xahead;}
+	else if(xahead >= BLOCK_WIDTH)	{xdir = BLOCK_NEIGHBOR_RIGHT;	xover = xahead - BLOCK_WIDTH;}
+	if(yahead < 0)					{ydir = BLOCK_NEIGHBOR_UP;		yover = -yahead;}
+	else if(yahead >= BLOCK_HEIGHT)	{ydir = BLOCK_NEIGHBOR_DOWN;	yover = yahead - BLOCK_HEIGHT;}
+	if(xdir >= 0 && (ydir < 0 || xover >= yover)){
+		plan->pan[n] = xdir;	plan->panSteps[n++] = (xover >= BLOCK_WIDTH) ? 2 : 1;
+		if(ydir >= 0){ plan->pan[n] = ydir;	plan->panSteps[n++] = (yover >= BLOCK_HEIGHT) ? 2 : 1; }
+	}
+	else if(ydir >= 0){
+		plan->pan[n] = ydir;	plan->panSteps[n++] = (yover >= BLOCK_HEIGHT) ? 2 : 1;
+		if(xdir >= 0){ plan->pan[n] = xdir;	plan->panSteps[n++] = (xover >= BLOCK_WIDTH) ? 2 : 1; }
+	}
+
+	// zooming. this is how many levels the camera will be above (positive) or below (negative) the target's level.
+	// camera_check() zooms in at -1 (scale = 1/3) and zooms out at +1 (scale = 3).
+	float levelsAhead = logf(cam->scale)/logf(BLOCK_LINEAR_SCALE_FACTOR) + velocityZoom*PREFETCH_HORIZON_FRAMES;
+	if(levelsAhead <= -1){
+		plan->diveDepth = (int)(-levelsAhead);
+		if(plan->diveDepth > PREFETCH_MAX_LEVELS) plan->diveDepth = PREFETCH_MAX_LEVELS;
+
+		// the children are the ones under the center of the camera (the same ones camera_check() will zoom in to).
+		float x = cam->x;
+		float y = cam->y;
+		int d;
+		for(d=0; d<plan->diveDepth; d++){
+			// keep the point inside the block
+			if(x < 0) x = 0;
+			if(x > BLOCK_WIDTH-1) x = BLOCK_WIDTH-1;
+			if(y < 0) y = 0;
+			if(y > BLOCK_HEIGHT-1) y = BLOCK_HEIGHT-1;
+			int cx = (int)x/BLOCK_WIDTH_1_3;
+			int cy = (int)y/BLOCK_HEIGHT_1_3;
+			plan->dive[d] = cx + 3*cy;
+			// the same point, on the child
+			x = (x - cx*BLOCK_WIDTH_1_3)*BLOCK_LINEAR_SCALE_FACTOR;
+			y = (y - cy*BLOCK_HEIGHT_1_3)*BLOCK_LINEAR_SCALE_FACTOR;
+		}
+	}
+	else if(levelsAhead >= 1){
+		plan->climb = (int)levelsAhead;
+		if(plan->climb > PREFETCH_MAX_LEVELS) plan->climb = PREFETCH_MAX_LEVELS;
+	}
+}
+
+
+
+/// this tells the prefetcher where the camera is.
+// call this once per frame (after the camera has been checked) with the block lock held.
+// the camera's velocity is tracked from frame to frame, so the prefetcher can generate the blocks in the direction the camera is moving first.
+// the prefetcher only starts over when the camera moves to a different target or starts heading somewhere else.
+void prefetch_update(struct cameraData *cam){
+
+	if(prefetchMutex == NULL || cam == NULL || cam->target == NULL) return;
+
+	// this is the camera's zoom in levels (so it doesn't jump when the camera moves from one level to the next).
+	float zoom = logf(cam->scale)/logf(BLOCK_LINEAR_SCALE_FACTOR) + cam->target->level;
+
+	if(lastTarget != NULL){
+		float zoomStep = zoom - lastZoom;
+		if(wheelNotches != 0)	velocityZoom = zoomStep;
+		else					velocityZoom += PREFETCH_VELOCITY_SMOOTHING*(zoomStep - velocityZoom);
+		// x and y are relative to the target, so they can only be compared while the target stays the same.
+		if(cam->target == lastTarget){
+			velocityX += PREFETCH_VELOCITY_SMOOTHING*((cam->x - lastX) - velocityX);
+			velocityY += PREFETCH_VELOCITY_SMOOTHING*((cam->y - lastY) - velocityY);
+		}
+	}
+	lastTarget = cam->target;
+	lastX = cam->x;
+	lastY = cam->y;
+	lastZoom = zoom;
+	wheelNotches = 0;
+
+	struct prefetchPlan plan;
+	memset(&plan, 0, sizeof(plan));
+	plan.target = cam->target;
+	plan.pan[0] = plan.pan[1] = -1;
+	prefetch_predict(cam, &plan);
+
+	SDL_LockMutex(prefetchMutex);
+	if(memcmp(&plan, &request, sizeof(plan)) != 0){
+		memcpy(&request, &plan, sizeof(plan));
+		requestNumber++;
+		SDL_CondSignal(prefetchWake);
+	}
+	SDL_UnlockMutex(prefetchMutex);
+}
+
+
+
+/// returns the number of blocks that the prefetcher has generated.
+long long prefetch_generated_count(){
+	return prefetchedCount;
+}
@@ -0,0 +1,28 @@
+//#include "block.h"
+//#include "camera.h"
+
+/// prefetch definitions
+// the prefetcher is a background thread that generates blocks around the camera before the camera needs them.
+// it keeps the four neighbors (and the four diagonal neighbors) of the camera's target, the target's children, and the target's parents generated.
+// it also keeps track of how the camera is moving. The blocks in the direction the camera is panning (or along the path it is zooming) are generated first, several levels deep if the camera is moving fast.
+// so when the camera pans or zooms, the blocks it moves to are already there and the main thread doesn't have to stop and generate them.
+// the slow part of generating a block (filling its elevation data) is done without holding the block lock (see block_lock()).
+// the new blocks are only linked into the network (published) while the lock is held.
+// blocks that are too deep to have an address (see "Block Addresses" in block.h) are left for the main thread to generate.
+
+// this is how many frames ahead the prefetcher looks when it works out where the camera is going.
+#define PREFETCH_HORIZON_FRAMES		20
+// this is the most levels the prefetcher will zoom in (dive) or zoom out (climb) along the path the camera is heading.
+#define PREFETCH_MAX_LEVELS		4
+// this is how much each new frame counts towards the camera's average velocity (0 to 1).
+#define PREFETCH_VELOCITY_SMOOTHING	0.3f
+
+
+// the files that call these don't all include camera.h, so it is just declared here.
+struct cameraData;
+
+short prefetch_init();
+void prefetch_quit();
+void prefetch_update(struct cameraData *cam);
+void prefetch_wheel(int notches);
+long long prefetch_generated_count();
@@ -4,6 +4,9 @@
 #include <time.h>
 #include "rand.h"
 #include "mt19937int.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 
 
@@ -78,7 +81,149 @@ void test_random_functions(unsigned long numbersToGen){
 
 
 
+/// this scrambles a 64-bit number into a random-looking 64-bit number.
+// this is the finalizer from the splitmix64 generator. Every input gives a different output.
+unsigned long long rand_hash64(unsigned long long x){
+	x += 0x9e3779b97f4a7c15ULL;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+
+
+/// this scrambles two 64-bit numbers together.
+// rand_combine(a, b) is not the same as rand_combine(b, a).
+unsigned long long rand_combine(unsigned long long a, unsigned long long b){
+	return rand_hash64(a ^ rand_hash64(b));
+}
 
 
 
+/// this returns the next number from a splitmix64 generator and advances its state.
+// the state can be seeded with any 64-bit number.
+unsigned long long rand_splitmix64(unsigned long long *state){
+	*state += 0x9e3779b97f4a7c15ULL;
+	unsigned long long x = *state;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+
+
+//--------------------------------------------------
+// Philox4x32-10 counter-based generator
+//--------------------------------------------------
+// Philox turns a 128-bit counter and a 64-bit key into 128 random bits (four 32-bit words).
+// there is no state to update, so any element of a random sequence can be computed directly and in any order.
+// reference: Salmon et al., "Parallel Random Numbers: As Easy as 1, 2, 3", SC 2011.
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+#define PHILOX_ROUNDS 10
+// this turns the top 24 bits of a random word into a float in [0, 1)
+#define RAND_FLOAT_UNIT (1.0f/16777216.0f)
+
+
+/// this computes the four random words for one Philox counter.
+static void rand_philox4x32(unsigned long long counter, unsigned long long key, unsigned int out[4]){
+	unsigned int x0 = (unsigned int)counter, x1 = (unsigned int)(counter >> 32), x2 = 0, x3 = 0;
+	unsigned int k0 = (unsigned int)key, k1 = (unsigned int)(key >> 32);
+	unsigned long long p0, p1;
+	int r;
+	for(r=0; r<PHILOX_ROUNDS; r++){
+		p0 = (unsigned long long)PHILOX_M0 * x0;
+		p1 = (unsigned long long)PHILOX_M1 * x2;
+		x0 = (unsigned int)(p1 >> 32) ^ x1 ^ k0;
+		x1 = (unsigned int)p1;
+		x2 = (unsigned int)(p0 >> 32) ^ x3 ^ k1;
+		x3 = (unsigned int)p0;
+		k0 += PHILOX_W0;
+		k1 += PHILOX_W1;
+	}
+	out[0] = x0;
+	out[1] = x1;
+	out[2] = x2;
+	out[3] = x3;
+}
 
+
+#if defined(__SSE2__)
+/// this multiplies each 32-bit lane of a by m and returns the low and high halves of the 64-bit products.
+static inline void rand_mulhilo_sse2(__m128i a, __m128i m, __m128i *lo, __m128i *hi){
+	// products of lanes 0 and 2, then of lanes 1 and 3
+	__m128i even = _mm_mul_epu32(a, m);
+	__m128i odd  = _mm_mul_epu32(_mm_srli_epi64(a, 32), m);
+	// even = [lo0 lo2 hi0 hi2], odd = [lo1 lo3 hi1 hi3]
+	even = _mm_shuffle_epi32(even, _MM_SHUFFLE(3,1,2,0));
+	odd  = _mm_shuffle_epi32(odd,  _MM_SHUFFLE(3,1,2,0));
+	*lo = _mm_unpacklo_epi32(even, odd);
+	*hi = _mm_unpackhi_epi32(even, odd);
+}
+#endif
+
+
+/// this fills dst[0] through dst[n-1] with random floats in [lo, hi).
+// element i is made from word i%4 of the Philox output for (counter + i/4, key).
+// so a big array can be filled in pieces (or by several threads) and it comes out exactly the same as filling it all at once,
+// as long as each piece starts on a multiple of 4 and passes counter + start/4.
+// the SSE2 version and the plain C version give bit-identical results.
+void rand_fill_float(float *dst, size_t n, float lo, float hi, unsigned long long key, unsigned long long counter){
+	
+	float range = hi - lo;
+	size_t i = 0;
+	
+#if defined(__SSE2__)
+	// do four counters (16 floats) at a time. Lane j of each vector works on counter + j.
+	const __m128i m0 = _mm_set1_epi32((int)PHILOX_M0);
+	const __m128i m1 = _mm_set1_epi32((int)PHILOX_M1);
+	const __m128 unit = _mm_set1_ps(RAND_FLOAT_UNIT);
+	const __m128 vrange = _mm_set1_ps(range);
+	const __m128 vlo = _mm_set1_ps(lo);
+	for(; i+16 <= n; i += 16, counter += 4){
+		__m128i x0 = _mm_set_epi32((int)(counter+3), (int)(counter+2), (int)(counter+1), (int)counter);
+		__m128i x1 = _mm_set_epi32((int)((counter+3)>>32), (int)((counter+2)>>32), (int)((counter+1)>>32), (int)(counter>>32));
+		__m128i x2 = _mm_setzero_si128();
+		__m128i x3 = _mm_setzero_si128();
+		__m128i k0 = _mm_set1_epi32((int)(unsigned int)key);
+		__m128i k1 = _mm_set1_epi32((int)(unsigned int)(key >> 32));
+		const __m128i w0 = _mm_set1_epi32((int)PHILOX_W0);
+		const __m128i w1 = _mm_set1_epi32((int)PHILOX_W1);
+		__m128i lo0, hi0, lo1, hi1;
+		int r;
+		for(r=0; r<PHILOX_ROUNDS; r++){
+			rand_mulhilo_sse2(x0, m0, &lo0, &hi0);
+			rand_mulhilo_sse2(x2, m1, &lo1, &hi1);
+			x0 = _mm_xor_si128(_mm_xor_si128(hi1, x1), k0);
+			x1 = lo1;
+			x2 = _mm_xor_si128(_mm_xor_si128(hi0, x3), k1);
+			x3 = lo0;
+			k0 = _mm_add_epi32(k0, w0);
+			k1 = _mm_add_epi32(k1, w1);
+		}
+		// convert the top 24 bits of each word to a float in [lo, hi)
+		__m128 f0 = _mm_add_ps(vlo, _mm_mul_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(x0, 8)), unit), vrange));
+		__m128 f1 = _mm_add_ps(vlo, _mm_mul_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(x1, 8)), unit), vrange));
+		__m128 f2 = _mm_add_ps(vlo, _mm_mul_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(x2, 8)), unit), vrange));
+		__m128 f3 = _mm_add_ps(vlo, _mm_mul_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(x3, 8)), unit), vrange));
+		// f0 holds word 0 of each of the four counters. Transpose so that each vector holds the four words of one counter.
+		_MM_TRANSPOSE4_PS(f0, f1, f2, f3);
+		_mm_storeu_ps(dst + i,      f0);
+		_mm_storeu_ps(dst + i + 4,  f1);
+		_mm_storeu_ps(dst + i + 8,  f2);
+		_mm_storeu_ps(dst + i + 12, f3);
+	}
+#endif
+	
+	// do the rest one counter (4 floats) at a time.
+	unsigned int words[4];
+	int w;
+	for(; i < n; counter++){
+		rand_philox4x32(counter, key, words);
+		for(w=0; w<4 && i<n; w++, i++){
+			dst[i] = lo + ((float)(words[w] >> 8) * RAND_FLOAT_UNIT) * range;
+		}
+	}
+}
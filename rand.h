@@ -2,6 +2,7 @@
 //#include <stdlib.h>
 //#include <time.h>
 #include "mt19937int.h"
+#include <stddef.h>
 
 
 // use lsgenrand() for getting a seed.
@@ -51,6 +52,22 @@ void test_random_functions(unsigned long);
 
 
 
+/// these are for generating repeatable random numbers (the same seed always gives the same numbers).
+// unlike genrand(), they do not share any state, so the order in which things are generated does not matter.
+
+// this scrambles a 64-bit number into a random-looking 64-bit number (the splitmix64 finalizer).
+unsigned long long rand_hash64(unsigned long long x);
+// this scrambles two 64-bit numbers together into one. The order of the arguments matters.
+unsigned long long rand_combine(unsigned long long a, unsigned long long b);
+// this returns the next random number from the state and advances the state (splitmix64).
+unsigned long long rand_splitmix64(unsigned long long *state);
+
+// this fills dst[] with n random floats in [lo, hi). Element i only depends on key and counter + i/4.
+// it is a counter-based generator (Philox4x32-10), so it has no state and it is safe to call from any thread.
+void rand_fill_float(float *dst, size_t n, float lo, float hi, unsigned long long key, unsigned long long counter);
+
+
+
 
 
 
@@ -0,0 +1,237 @@
+#include "block.h"
+#include "texture_cache.h"
+#include <SDL2/SDL.h>
+#include <stdlib.h>
+#include "utilities.h"
+
+
+/// this is one texture in the cache, and the block it is holding the image of.
+struct textureCacheEntry{
+	// this is the block whose image is in the texture. NULL means the texture is free to be used for any block.
+	struct blockData *block;
+	SDL_Texture *texture;
+	// these are the entries that were drawn just after and just before this one (-1 if there aren't any).
+	// they link all of the entries into a list from the most recently drawn (newestEntry) to the least recently drawn (oldestEntry).
+	// free entries are always at the oldest end of the list.
+	int newer, older;
+};
+
+
+// these are all of the textures that have been created.
+static struct textureCacheEntry *entries = NULL;
+// this is how many textures have been created.
+static int entryCount = 0;
+// this is how many entries the entries array can hold before it needs to grow.
+static int entryArraySize = 0;
+// this is the maximum number of textures allowed.
+static int maxTextures = TEXTURE_CACHE_DEFAULT_MAX_TEXTURES;
+// these are the ends of the list of entries (see struct textureCacheEntry). They are -1 when there are no entries.
+static int newestEntry = -1;
+static int oldestEntry = -1;
+// this is how many times a texture has been taken away from one block to hold another one.
+static long long evictedCount = 0;
+
+
+
+/// this takes entry e out of the list of entries.
+static void texture_cache_unlink(int e){
+	if(entries[e].newer >= 0) entries[entries[e].newer].older = entries[e].older;
+	else newestEntry = entries[e].older;
+	if(entries[e].older >= 0) entries[entries[e].older].newer = entries[e].newer;
+	else oldestEntry = entries[e].newer;
+}
+
+
+
+/// this puts entry e at the newest end of the list of entries (it was just drawn).
+static void texture_cache_link_newest(int e){
+	entries[e].newer = -1;
+	entries[e].older = newestEntry;
+	if(newestEntry >= 0) entries[newestEntry].newer = e;
+	else oldestEntry = e;
+	newestEntry = e;
+}
+
+
+
+/// this puts entry e at the oldest end of the list of entries (it is free, so it should be the next one used).
+static void texture_cache_link_oldest(int e){
+	entries[e].older = -1;
+	entries[e].newer = oldestEntry;
+	if(oldestEntry >= 0) entries[oldestEntry].older = e;
+	else newestEntry = e;
+	oldestEntry = e;
+}
+
+
+
+/// returns the entry that holds the image of block, or -1 if the block isn't in the cache.
+static int texture_cache_find(struct blockData *block){
+	int e = block->textureEntry;
+	// the block remembers its entry, but the entry could have been given to another block since then.
+	if(e >= 0 && e < entryCount && entries[e].block == block) return e;
+	return -1;
+}
+
+
+
+/// this destroys the texture in entry e and takes the entry out of the cache.
+static void texture_cache_destroy(int e){
+	texture_cache_unlink(e);
+	SDL_DestroyTexture(entries[e].texture);
+	// the last entry fills the hole. Everything that knows the last entry by its index has to be told where it went.
+	int last = entryCount-1;
+	if(e != last){
+		entries[e] = entries[last];
+		if(entries[e].newer >= 0) entries[entries[e].newer].older = e;
+		else newestEntry = e;
+		if(entries[e].older >= 0) entries[entries[e].older].newer = e;
+		else oldestEntry = e;
+		if(entries[e].block != NULL) entries[e].block->textureEntry = e;
+	}
+	entryCount--;
+}
+
+
+
+/// this sets the maximum number of textures that will be kept.
+// textures beyond the new maximum are destroyed (the least recently used ones first).
+void texture_cache_set_max_textures(int max){
+	if(max < TEXTURE_CACHE_MIN_TEXTURES) max = TEXTURE_CACHE_MIN_TEXTURES;
+	maxTextures = max;
+	while(entryCount > maxTextures){
+		texture_cache_destroy(oldestEntry);
+	}
+	gamelog_d("texture_cache_set_max_textures() set maxTextures =", maxTextures);
+}
+
+
+
+/// this sets the maximum number of bytes of textures that will be kept.
+// each texture is BLOCK_WIDTH x BLOCK_HEIGHT pixels at 4 bytes per pixel. The budget is rounded down to a whole number of textures.
+void texture_cache_set_max_bytes(long long maxBytes){
+	long long max = maxBytes/(BLOCK_WIDTH*BLOCK_HEIGHT*4);
+	if(max > 0x7fffffff) max = 0x7fffffff;
+	texture_cache_set_max_textures((int)max);
+}
+
+
+
+/// this finds an entry to hold a block that isn't in the cache yet.
+// a free texture is used first, then a new one is created if there is room in the budget, and if there isn't, the least recently used texture is taken.
+// returns the entry, or -1 if no texture could be found or created.
+static int texture_cache_find_room(SDL_Renderer *renderer){
+
+	// the free entries are at the oldest end of the list, so if there is a free one, it is the oldest.
+	if(oldestEntry >= 0 && entries[oldestEntry].block == NULL) return oldestEntry;
+
+	if(entryCount < maxTextures){
+		// make room in the array for another entry
+		if(entryCount >= entryArraySize){
+			int newSize = entryArraySize ? entryArraySize*2 : 16;
+			struct textureCacheEntry *newEntries = realloc(entries, newSize*sizeof(struct textureCacheEntry));
+			if(newEntries == NULL){
+				error_d("texture_cache_find_room() could not grow the entry array. newSize =", newSize);
+				return oldestEntry;
+			}
+			entries = newEntries;
+			entryArraySize = newSize;
+		}
+		SDL_Texture *texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, BLOCK_WIDTH, BLOCK_HEIGHT);
+		if(texture == NULL){
+			error("texture_cache_find_room() could not create a new texture.");
+			return oldestEntry;
+		}
+		entries[entryCount].block = NULL;
+		entries[entryCount].texture = texture;
+		texture_cache_link_oldest(entryCount);
+		return entryCount++;
+	}
+
+	// the budget is full. The block that was drawn the longest time ago loses its texture.
+	return oldestEntry;
+}
+
+
+
+/// this returns a texture that has the up-to-date image of block in it.
+// the block is only rendered if it is new to the cache or if its elevation has changed (see block_mark_dirty()). Only the parts that changed are rendered.
+// returns NULL if there is no texture for the block.
+SDL_Texture *texture_cache_get(SDL_Renderer *renderer, struct blockData *block){
+
+	if(renderer == NULL || block == NULL){
+		error("texture_cache_get() was sent a NULL renderer or block.");
+		return NULL;
+	}
+
+	int e = texture_cache_find(block);
+	if(e < 0){
+		e = texture_cache_find_room(renderer);
+		if(e < 0) return NULL;
+		if(entries[e].block != NULL) evictedCount++;
+		entries[e].block = block;
+		block->textureEntry = e;
+		// the texture has somebody else's image in it.
+		block_mark_all_dirty(block);
+	}
+
+	if(block_is_dirty(block)) block_render(block, entries[e].texture);
+	if(e != newestEntry){
+		texture_cache_unlink(e);
+		texture_cache_link_newest(e);
+	}
+	return entries[e].texture;
+}
+
+
+
+/// this gives up the texture of block (if it has one) so it can be used for another block.
+// this needs to be called before a block is freed. Otherwise a new block that ends up at the same address would be drawn with the old block's image.
+void texture_cache_release(struct blockData *block){
+	int e = texture_cache_find(block);
+	if(e < 0) return;
+	entries[e].block = NULL;
+	// it is free now, so it goes with the other free entries.
+	texture_cache_unlink(e);
+	texture_cache_link_oldest(e);
+}
+
+
+
+/// this gives up the textures of all of the blocks, so every block is rendered again the next time it is drawn.
+// use this when the way blocks are drawn changes (like a new colormap).
+void texture_cache_invalidate(){
+	int e;
+	// every entry is free after this, so the order of the list doesn't matter.
+	for(e=0; e<entryCount; e++){
+		entries[e].block = NULL;
+	}
+}
+
+
+
+/// returns the number of textures that have been created.
+int texture_cache_count(){
+	return entryCount;
+}
+
+
+
+/// returns the number of times a texture has been taken away from a block so it could be used for another block.
+long long texture_cache_evicted_count(){
+	return evictedCount;
+}
+
+
+
+/// this destroys all of the textures.
+// call this before the renderer is destroyed.
+void texture_cache_clean_up(){
+	while(entryCount > 0){
+		texture_cache_destroy(entryCount-1);
+	}
+	free(entries);
+	entries = NULL;
+	entryArraySize = 0;
+	newestEntry = oldestEntry = -1;
+}
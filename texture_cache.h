@@ -0,0 +1,24 @@
+//#include "block.h"
+
+/// texture cache definitions
+// the texture cache holds the rendered images (SDL_Textures) of the blocks that have been drawn recently.
+// the blocks themselves don't own textures. Each block remembers which entry of the cache has its image (blockData.textureEntry), so finding it doesn't need a search.
+// there is a budget for how many textures can exist at once. When it is full, the texture of the least recently drawn block is taken away from that block and reused for the new one.
+// every texture is BLOCK_WIDTH x BLOCK_HEIGHT, so a texture never has to be destroyed and created again just because it moved to a different block.
+// the textures are streaming textures, so blocks are rendered by writing straight into them (see block_render()).
+// the texture cache is only used by the main thread (the one that owns the renderer).
+
+// this is the default maximum number of textures. Each texture is about 236 kB, so this is about 30 MB.
+#define TEXTURE_CACHE_DEFAULT_MAX_TEXTURES	128
+// the budget can't go lower than this. A frame draws up to 4 blocks, and a little room is left for the blocks around them.
+#define TEXTURE_CACHE_MIN_TEXTURES			9
+
+
+void texture_cache_set_max_textures(int maxTextures);
+void texture_cache_set_max_bytes(long long maxBytes);
+SDL_Texture *texture_cache_get(SDL_Renderer *renderer, struct blockData *block);
+void texture_cache_release(struct blockData *block);
+void texture_cache_invalidate();
+int texture_cache_count();
+long long texture_cache_evicted_count();
+void texture_cache_clean_up();
@@ -0,0 +1,230 @@
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "block.h"
+#include "trace.h"
+#include "utilities.h"
+
+// nothing in here is compiled unless tracing is turned on (see trace.h).
+#ifdef FRACTALMAP_TRACE
+
+
+/// this is the buffer one thread records its events in.
+// only the thread it belongs to writes to it. It is only read after tracing is over.
+struct traceBuffer{
+	SDL_threadID thread;
+	// this is the name of the thread (see trace_thread_name()). It can be NULL.
+	const char *name;
+	// this is how many events have been recorded. It is set after each event is written.
+	SDL_atomic_t count;
+	// this is how many events didn't fit.
+	long long dropped;
+	struct traceEvent events[TRACE_BUFFER_EVENTS];
+};
+
+
+// this is the file the trace is written to. It is NULL when tracing isn't running.
+static const char *traceFile = NULL;
+// this is when tracing started. Every time in the trace is from here.
+static Uint64 traceEpoch = 0;
+// this holds each thread's buffer (so a thread can find its own buffer without looking through all of them).
+static SDL_TLSID traceKey = 0;
+// these are the buffers of all of the threads that have recorded events.
+// a thread gets the next slot by adding 1 to traceBufferCount, so the threads never need a lock to get one.
+static struct traceBuffer *traceBuffers[TRACE_MAX_THREADS];
+static SDL_atomic_t traceBufferCount;
+// a thread that couldn't get a buffer has this put in its thread local storage instead, so it only tries (and logs the error) once.
+// nothing is ever recorded in it.
+static struct traceBuffer traceNoBuffer;
+
+
+
+/// this starts recording events. The trace is written to fileName by trace_quit().
+// this needs to be called before any of the other threads are started.
+// returns 0 on success
+// returns 1 on NULL fileName
+// returns 2 if the thread local storage could not be created
+short trace_init(const char *fileName){
+
+	if(fileName == NULL){
+		error("trace_init() was sent NULL fileName. fileName = NULL");
+		return 1;
+	}
+	traceKey = SDL_TLSCreate();
+	if(traceKey == 0){
+		error("trace_init() could not create the thread local storage for the trace buffers.");
+		return 2;
+	}
+	SDL_AtomicSet(&traceBufferCount, 0);
+	traceEpoch = SDL_GetPerformanceCounter();
+	traceFile = fileName;
+	return 0;
+}
+
+
+
+/// returns the buffer of the calling thread (it is made the first time the thread records something).
+// returns NULL if tracing isn't running, or the thread couldn't get a buffer.
+static struct traceBuffer *trace_buffer(){
+
+	if(traceFile == NULL) return NULL;
+	struct traceBuffer *buffer = SDL_TLSGet(traceKey);
+	if(buffer == &traceNoBuffer) return NULL;
+	if(buffer != NULL) return buffer;
+
+	int slot = SDL_AtomicAdd(&traceBufferCount, 1);
+	if(slot >= TRACE_MAX_THREADS){
+		error_d("trace_buffer() ran out of trace buffers. This thread's events won't be recorded. slot =", slot);
+		SDL_TLSSet(traceKey, &traceNoBuffer, NULL);
+		return NULL;
+	}
+	buffer = malloc(sizeof(struct traceBuffer));
+	if(buffer == NULL){
+		error("trace_buffer() could not allocate a trace buffer. This thread's events won't be recorded. buffer = NULL");
+		SDL_TLSSet(traceKey, &traceNoBuffer, NULL);
+		return NULL;
+	}
+	buffer->thread = SDL_ThreadID();
+	buffer->name = NULL;
+	SDL_AtomicSet(&buffer->count, 0);
+	buffer->dropped = 0;
+	// the buffer is kept after the thread is done, so there is no destructor.
+	SDL_TLSSet(traceKey, buffer, NULL);
+	traceBuffers[slot] = buffer;
+	return buffer;
+}
+
+
+
+/// this gives the calling thread a name in the trace (like "worker").
+void trace_thread_name(const char *name){
+	struct traceBuffer *buffer = trace_buffer();
+	if(buffer != NULL) buffer->name = name;
+}
+
+
+
+/// this starts an event that isn't about any block (see TRACE_SCOPE()).
+struct traceEvent trace_begin(const char *name){
+	struct traceEvent event = {0};
+	if(traceFile == NULL) return event;
+	event.name = name;
+	event.start = SDL_GetPerformanceCounter();
+	return event;
+}
+
+
+
+/// this starts an event about block (see TRACE_BLOCK()).
+// the address is only recorded if the block has a valid address (see "Block Addresses" in block.h). The level is recorded either way.
+struct traceEvent trace_begin_block(const char *name, const struct blockData *block){
+	struct traceEvent event = trace_begin(name);
+	if(event.name == NULL || block == NULL) return event;
+	event.hasLevel = 1;
+	event.level = block->level;
+	if(block->addressValid){
+		event.hasAddress = 1;
+		event.x = block->addressX;
+		event.y = block->addressY;
+	}
+	return event;
+}
+
+
+
+/// this starts an event about the address (level, x, y) (see TRACE_ADDRESS()).
+struct traceEvent trace_begin_address(const char *name, signed long long level, long long x, long long y){
+	struct traceEvent event = trace_begin(name);
+	if(event.name == NULL) return event;
+	event.hasLevel = 1;
+	event.hasAddress = 1;
+	event.level = level;
+	event.x = x;
+	event.y = y;
+	return event;
+}
+
+
+
+/// this ends an event and records it in the calling thread's buffer.
+// the scope macros call this when the scope is left.
+void trace_end(struct traceEvent *event){
+
+	if(event->name == NULL) return;
+	struct traceBuffer *buffer = trace_buffer();
+	if(buffer == NULL) return;
+
+	int count = SDL_AtomicGet(&buffer->count);
+	if(count >= TRACE_BUFFER_EVENTS){
+		buffer->dropped++;
+		return;
+	}
+	event->end = SDL_GetPerformanceCounter();
+	buffer->events[count] = *event;
+	// the count goes up after the event is written, so anyone reading the buffer only sees whole events.
+	SDL_AtomicSet(&buffer->count, count+1);
+}
+
+
+
+/// this stops recording events and writes the trace to the file given to trace_init().
+// all of the other threads need to be finished first (see clean_up()).
+// returns 0 on success
+// returns 1 if tracing wasn't running
+// returns 2 if the file could not be opened
+short trace_quit(){
+
+	if(traceFile == NULL) return 1;
+	const char *fileName = traceFile;
+	// stop recording before the buffers are read.
+	traceFile = NULL;
+
+	FILE *fp = fopen(fileName, "w");
+	if(fp == NULL){
+		error("trace_quit() could not open the trace file:");
+		error((char *)fileName);
+		return 2;
+	}
+
+	// the times in the trace are in microseconds
+	double ticksPerUs = SDL_GetPerformanceFrequency()/1000000.0;
+	int buffers = SDL_AtomicGet(&traceBufferCount);
+	if(buffers > TRACE_MAX_THREADS) buffers = TRACE_MAX_THREADS;
+	long long events = 0, dropped = 0;
+	char first = 1;
+	int b, e;
+
+	fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+	for(b=0; b<buffers; b++){
+		struct traceBuffer *buffer = traceBuffers[b];
+		if(buffer == NULL) continue;
+		unsigned long tid = (unsigned long)buffer->thread;
+		if(buffer->name != NULL){
+			fprintf(fp, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%lu,\"args\":{\"name\":\"%s\"}}", first ? "" : ",", tid, buffer->name);
+			first = 0;
+		}
+		int count = SDL_AtomicGet(&buffer->count);
+		for(e=0; e<count; e++){
+			struct traceEvent *event = &buffer->events[e];
+			fprintf(fp, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%lu,\"ts\":%.3f,\"dur\":%.3f", first ? "" : ",", event->name, tid, (event->start - traceEpoch)/ticksPerUs, (event->end - event->start)/ticksPerUs);
+			if(event->hasAddress) fprintf(fp, ",\"args\":{\"level\":%lld,\"x\":%lld,\"y\":%lld}", event->level, event->x, event->y);
+			else if(event->hasLevel) fprintf(fp, ",\"args\":{\"level\":%lld}", event->level);
+			fprintf(fp, "}");
+			first = 0;
+		}
+		events += count;
+		dropped += buffer->dropped;
+		free(buffer);
+		traceBuffers[b] = NULL;
+	}
+	fprintf(fp, "\n]}\n");
+	fclose(fp);
+
+	gamelog_d("trace_quit() wrote the trace. events =", (int)events);
+	if(dropped) gamelog_d("trace_quit() some events didn't fit in the trace buffers. dropped =", (int)dropped);
+	SDL_AtomicSet(&traceBufferCount, 0);
+	return 0;
+}
+
+
+#endif // FRACTALMAP_TRACE
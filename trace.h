@@ -0,0 +1,73 @@
+/// trace definitions
+// tracing records when each instrumented function started and how long it took, on every thread, so the run can be looked at on a timeline.
+// the trace is written as Chrome trace JSON when the program quits (open it with chrome://tracing or https://ui.perfetto.dev).
+// tracing is only compiled in when FRACTALMAP_TRACE is defined (add -DFRACTALMAP_TRACE to the compiler options).
+// otherwise all of the TRACE_ macros are empty, and nothing in trace.c is compiled, so a normal build doesn't pay anything for it.
+//
+// a function is instrumented by putting one of these at the top of it (after the declarations it needs):
+//	TRACE_SCOPE(name)				records the time until the function (or the enclosing braces) is left
+//	TRACE_BLOCK(name, block)		the same, and it records the level and address of block too (block can be NULL)
+//	TRACE_ADDRESS(name, level, x, y)	the same, with an address that doesn't belong to a block yet
+// name has to be a string that doesn't go away (a string literal).
+// the end of the event is recorded by a cleanup function that GCC calls when the scope is left, so every return is covered without any extra code.
+//
+// each thread records its events in its own buffer, so the threads never wait on each other (or on a lock) to record an event.
+// when a thread's buffer is full, its new events are dropped (and counted).
+
+#ifdef FRACTALMAP_TRACE
+
+// this is the file the trace is written to.
+#define TRACE_DEFAULT_FILE		"trace.json"
+// this is the most threads that can record events.
+#define TRACE_MAX_THREADS		80
+// this is how many events each thread can record.
+#define TRACE_BUFFER_EVENTS		65536
+
+/// this is one event (from when it started until when it ended).
+// a scope macro keeps one of these on the stack until the scope is left.
+struct traceEvent{
+	// this is NULL if tracing wasn't started (or had already been written) when the event started.
+	const char *name;
+	// these are performance counter values (see SDL_GetPerformanceCounter()).
+	Uint64 start, end;
+	// this is the block the event is about. level is only set if hasLevel is set, and x and y are only set if hasAddress is set
+	// (a block that doesn't have a valid address still has a level, see "Block Addresses" in block.h).
+	char hasLevel;
+	char hasAddress;
+	signed long long level;
+	long long x, y;
+};
+
+// the files that trace things don't all include block.h, so it is just declared here.
+struct blockData;
+
+short trace_init(const char *fileName);
+void trace_thread_name(const char *name);
+struct traceEvent trace_begin(const char *name);
+struct traceEvent trace_begin_block(const char *name, const struct blockData *block);
+struct traceEvent trace_begin_address(const char *name, signed long long level, long long x, long long y);
+void trace_end(struct traceEvent *event);
+short trace_quit();
+
+// these glue __LINE__ onto the name of the scope variable, so a function can have more than one scope.
+#define TRACE_JOIN_(a, b)	a##b
+#define TRACE_JOIN(a, b)	TRACE_JOIN_(a, b)
+#define TRACE_VAR			TRACE_JOIN(traceEvent_, __LINE__)
+
+#define TRACE_INIT(fileName)				trace_init(fileName)
+#define TRACE_THREAD_NAME(name)				trace_thread_name(name)
+#define TRACE_SCOPE(name)					struct traceEvent TRACE_VAR __attribute__((cleanup(trace_end))) = trace_begin(name)
+#define TRACE_BLOCK(name, block)			struct traceEvent TRACE_VAR __attribute__((cleanup(trace_end))) = trace_begin_block(name, block)
+#define TRACE_ADDRESS(name, level, x, y)	struct traceEvent TRACE_VAR __attribute__((cleanup(trace_end))) = trace_begin_address(name, level, x, y)
+#define TRACE_QUIT()						trace_quit()
+
+#else
+
+#define TRACE_INIT(fileName)
+#define TRACE_THREAD_NAME(name)
+#define TRACE_SCOPE(name)
+#define TRACE_BLOCK(name, block)
+#define TRACE_ADDRESS(name, level, x, y)
+#define TRACE_QUIT()
+
+#endif
@@ -2,79 +2,62 @@
 #include "utilities.h"
 #include "globals.h"
 #include "block.h"
-
+#include "block_pool.h"
+#include "block_index.h"
+#include "camera.h"
+#include "worker.h"
+#include "prefetch.h"
+#include "texture_cache.h"
+#include "trace.h"
+#include "logger.h"
+
+
+// length is what snprintf() returned when the line was formatted. If the line was too long, snprintf() cut the newline off with the rest of it,
+// so it is put back (otherwise the next line would be stuck onto the end of this one).
+static void line_end(char *line, int length){
+	if(length >= LOGGER_LINE_SIZE) line[LOGGER_LINE_SIZE-2] = '\n';
+}
 
 // this will log an error message to the error file
+// the line goes through the logger (see logger.h), so this doesn't wait on the disk.
 void error(char *errstr){
-	// open error log file
-	FILE *fp = fopen(ERROR_FILE, ERROR_FILE_MODE);
-	// if the error file is valid,
-	if(fp != NULL){
-		// write error log to error file
-		fprintf( fp, ERROR_FORMAT, ERROR_TIMESTAMP, errstr );
-		// close error fille
-		fclose(fp);
-	}
+	char line[LOGGER_LINE_SIZE];
+	line_end(line, snprintf(line, sizeof(line), ERROR_FORMAT, ERROR_TIMESTAMP, errstr));
+	logger_write(LOGGER_LEVEL_ERROR, errstr, line);
 }
 
 // this will log an error message and an integer of data to the error file
 void error_d(char *errstr, int data){
-	// open error log file
-	FILE *fp = fopen(ERROR_FILE,ERROR_FILE_MODE);
-	// if the error file is valid,
-	if(fp != NULL){
-		// write error log to error file
-		fprintf( fp, ERROR_FORMAT_D, ERROR_TIMESTAMP, errstr, data );
-		// close error fille
-		fclose(fp);
-	}
+	char line[LOGGER_LINE_SIZE];
+	line_end(line, snprintf(line, sizeof(line), ERROR_FORMAT_D, ERROR_TIMESTAMP, errstr, data));
+	logger_write(LOGGER_LEVEL_ERROR, errstr, line);
 }
 
 // this will log an error message and a floating point number to the error file
 void error_f(char *errstr, float data){
-	// open error log file 
-	FILE *fp = fopen(ERROR_FILE,ERROR_FILE_MODE);
-	// if the error file is valid,
-	if(fp != NULL){
-		// write error log to error file
-		fprintf( fp, ERROR_FORMAT_F, ERROR_TIMESTAMP, errstr, data );
-		// close error fille
-		fclose(fp);
-	}
+	char line[LOGGER_LINE_SIZE];
+	line_end(line, snprintf(line, sizeof(line), ERROR_FORMAT_F, ERROR_TIMESTAMP, errstr, data));
+	logger_write(LOGGER_LEVEL_ERROR, errstr, line);
 }
 
 
+// this will log a message to the gamelog
 void gamelog(char *gamestr){
-	FILE *fp = fopen(GAMELOG_FILE, GAMELOG_FILE_MODE);
-	// if the error file is valid,
-	if(fp != NULL){
-		// write error log to error file
-		fprintf( fp, GAMELOG_FORMAT, GAMELOG_TIMESTAMP, gamestr);
-		// close error fille
-		fclose(fp);
-	}
+	char line[LOGGER_LINE_SIZE];
+	line_end(line, snprintf(line, sizeof(line), GAMELOG_FORMAT, GAMELOG_TIMESTAMP, gamestr));
+	logger_write(LOGGER_LEVEL_INFO, gamestr, line);
 }
 
 void gamelog_d(char *gamestr, int data){
-	FILE *fp = fopen(GAMELOG_FILE, GAMELOG_FILE_MODE);
-	// if the error file is valid,
-	if(fp != NULL){
-		// write error log to error file
-		fprintf( fp, GAMELOG_FORMAT_D, GAMELOG_TIMESTAMP, gamestr, data);
-		// close error fille
-		fclose(fp);
-	}
+	char line[LOGGER_LINE_SIZE];
+	line_end(line, snprintf(line, sizeof(line), GAMELOG_FORMAT_D, GAMELOG_TIMESTAMP, gamestr, data));
+	logger_write(LOGGER_LEVEL_INFO, gamestr, line);
 }
 
 void gamelog_f(char *gamestr, float data){
-	FILE *fp = fopen(GAMELOG_FILE, GAMELOG_FILE_MODE);
-	// if the error file is valid,
-	if(fp != NULL){
-		// write error log to error file
-		fprintf( fp, GAMELOG_FORMAT_F, GAMELOG_TIMESTAMP, gamestr, data);
-		// close error fille
-		fclose(fp);
-	}
+	char line[LOGGER_LINE_SIZE];
+	line_end(line, snprintf(line, sizeof(line), GAMELOG_FORMAT_F, GAMELOG_TIMESTAMP, gamestr, data));
+	logger_write(LOGGER_LEVEL_INFO, gamestr, line);
 }
 
 
@@ -108,12 +91,22 @@ SDL_Surface *create_surface(int width, int height){
 
 void clean_up(){
 	
-	// destroy the main window, main renderer, and main texture.
+	// the block textures belong to the main renderer, so they go first.
+	texture_cache_clean_up();
+	// destroy the main window and main renderer.
 	SDL_DestroyRenderer(myRenderer);
-	SDL_DestroyTexture(myTexture);
 	SDL_DestroyWindow(myWindow);
+	// stop the prefetcher and the worker threads before the blocks they might be working on go away.
+	prefetch_quit();
+	worker_quit();
+	// all of the threads are done recording events, so the trace can be written (if tracing was compiled in, see trace.h).
+	TRACE_QUIT();
 	// erase all of the blocks that have been generated over the run time of the program.
-	block_collector(NULL, bc_clean_up);
+	block_pool_clean_up();
+	block_index_clean_up();
+	block_lock_quit();
+	// write out everything that is still waiting to be logged. After this, logging goes straight to the files.
+	logger_quit();
 	
 	SDL_Quit();
 	
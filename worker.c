@@ -0,0 +1,223 @@
+#include <SDL2/SDL.h>
+#include "worker.h"
+#include "utilities.h"
+#include "trace.h"
+
+
+/// this is one job that has been handed to the workers.
+// it lives on the stack of the thread that called worker_run().
+struct workerJob{
+	workerTask task;
+	void *data;
+	// this is how many times the task needs to be called.
+	int count;
+	// this is the next index that will be handed out.
+	int next;
+	// this is how many indexes have been finished.
+	int done;
+	// this is the next job in the list of jobs that still have indexes to hand out.
+	struct workerJob *nextJob;
+};
+
+
+// this protects everything below it.
+static SDL_mutex *workerMutex = NULL;
+// the workers wait on this when there is nothing to do.
+static SDL_cond *workerWake = NULL;
+// the threads that submitted jobs wait on this for their jobs to finish.
+static SDL_cond *workerFinished = NULL;
+// this is the list of jobs that still have indexes to hand out.
+static struct workerJob *jobList = NULL;
+// these are the worker threads.
+static SDL_Thread *workerThreads[WORKER_MAX_THREADS];
+static int workerThreadCount = 0;
+// this is set to 1 to tell the workers to quit.
+static int workerQuit = 0;
+
+
+
+/// this hands out the next index of the first job in the list.
+// workerMutex must be locked when this is called.
+// returns 1 and sets job and index if there was something to do.
+// returns 0 if every index of every job has already been handed out.
+static int worker_take(struct workerJob **job, int *index){
+
+	if(jobList == NULL) return 0;
+
+	*job = jobList;
+	*index = jobList->next++;
+	// once the last index has been handed out, the job doesn't need to be in the list anymore.
+	if(jobList->next >= jobList->count) jobList = jobList->nextJob;
+
+	return 1;
+}
+
+
+
+/// this is what each worker thread runs.
+static int worker_thread(void *unused){
+
+	(void)unused;
+	struct workerJob *job;
+	int index;
+	TRACE_THREAD_NAME("worker");
+
+	SDL_LockMutex(workerMutex);
+	while(!workerQuit){
+		if(worker_take(&job, &index)){
+			// run the task without holding the lock so that the other workers can get their own indexes.
+			SDL_UnlockMutex(workerMutex);
+			job->task(job->data, index);
+			SDL_LockMutex(workerMutex);
+			job->done++;
+			if(job->done >= job->count) SDL_CondBroadcast(workerFinished);
+		}
+		else{
+			SDL_CondWait(workerWake, workerMutex);
+		}
+	}
+	SDL_UnlockMutex(workerMutex);
+
+	return 0;
+}
+
+
+
+/// this starts the worker threads.
+// if threads is 0 (or less), one thread is started for every CPU except the one the main thread is using.
+// if no threads can be started, worker_run() just does all of the work on the calling thread.
+// returns 0 on success
+// returns 1 if the workers were already started
+// returns 2 if the mutex or condition variables could not be created
+short worker_init(int threads){
+
+	if(workerMutex != NULL){
+		error("worker_init() was called twice.");
+		return 1;
+	}
+
+	if(threads <= 0) threads = SDL_GetCPUCount() - 1;
+	if(threads > WORKER_MAX_THREADS) threads = WORKER_MAX_THREADS;
+
+	workerMutex = SDL_CreateMutex();
+	workerWake = SDL_CreateCond();
+	workerFinished = SDL_CreateCond();
+	if(workerMutex == NULL || workerWake == NULL || workerFinished == NULL){
+		error("worker_init() could not create the worker mutex and condition variables.");
+		return 2;
+	}
+
+	workerQuit = 0;
+	workerThreadCount = 0;
+	int t;
+	for(t=0; t<threads; t++){
+		workerThreads[workerThreadCount] = SDL_CreateThread(worker_thread, "worker", NULL);
+		if(workerThreads[workerThreadCount] == NULL){
+			error_d("worker_init() could not create worker thread. t =", t);
+			break;
+		}
+		workerThreadCount++;
+	}
+
+	gamelog_d("worker_init() started worker threads. workerThreadCount =", workerThreadCount);
+	return 0;
+}
+
+
+
+/// this stops all of the worker threads and waits for them to finish.
+void worker_quit(){
+
+	if(workerMutex == NULL) return;
+
+	SDL_LockMutex(workerMutex);
+	workerQuit = 1;
+	SDL_CondBroadcast(workerWake);
+	SDL_UnlockMutex(workerMutex);
+
+	int t;
+	for(t=0; t<workerThreadCount; t++){
+		SDL_WaitThread(workerThreads[t], NULL);
+	}
+	workerThreadCount = 0;
+
+	SDL_DestroyCond(workerFinished);
+	SDL_DestroyCond(workerWake);
+	SDL_DestroyMutex(workerMutex);
+	workerFinished = NULL;
+	workerWake = NULL;
+	workerMutex = NULL;
+}
+
+
+
+/// returns the number of worker threads that are running.
+int worker_count(){
+	return workerThreadCount;
+}
+
+
+
+/// this calls task(data, index) for every index from 0 to count-1, spread out over the worker threads.
+// the calling thread works on the job too, and this doesn't return until every index is done.
+// any thread can call this (more than one job can be running at once).
+// returns 0 on success
+// returns 1 on NULL task
+short worker_run(workerTask task, void *data, int count){
+
+	if(task == NULL){
+		error("worker_run() was sent NULL task. task = NULL");
+		return 1;
+	}
+	if(count <= 0) return 0;
+
+	int index;
+
+	// without any workers, just do everything here.
+	if(workerMutex == NULL || workerThreadCount == 0){
+		for(index=0; index<count; index++){
+			task(data, index);
+		}
+		return 0;
+	}
+
+	struct workerJob job;
+	job.task = task;
+	job.data = data;
+	job.count = count;
+	job.next = 0;
+	job.done = 0;
+	job.nextJob = NULL;
+
+	SDL_LockMutex(workerMutex);
+
+	// add the job to the end of the list and wake up the workers
+	struct workerJob **end = &jobList;
+	while(*end != NULL) end = &(*end)->nextJob;
+	*end = &job;
+	SDL_CondBroadcast(workerWake);
+
+	// help out with this job until all of its indexes have been handed out
+	while(job.next < job.count){
+		index = job.next++;
+		if(job.next >= job.count){
+			// take the job out of the list
+			struct workerJob **link = &jobList;
+			while(*link != &job) link = &(*link)->nextJob;
+			*link = job.nextJob;
+		}
+		SDL_UnlockMutex(workerMutex);
+		task(data, index);
+		SDL_LockMutex(workerMutex);
+		job.done++;
+	}
+
+	// wait for the workers to finish the indexes they took
+	while(job.done < job.count){
+		SDL_CondWait(workerFinished, workerMutex);
+	}
+
+	SDL_UnlockMutex(workerMutex);
+
+	return 0;
+}
@@ -0,0 +1,15 @@
+/// worker definitions
+// the workers are a pool of threads that split up big jobs (like generating 9 children at once).
+// a job is a task function that is called once for every index from 0 to count-1.
+// the thread that submits a job helps work on it, and it doesn't return until every index is done.
+
+// this is the most worker threads there can be.
+#define WORKER_MAX_THREADS		64
+
+// this is the type of function that the workers run. index goes from 0 to count-1.
+typedef void (*workerTask)(void *data, int index);
+
+short worker_init(int threads);
+void worker_quit();
+int worker_count();
+short worker_run(workerTask task, void *data, int count);